@@ -0,0 +1,320 @@
+/*
+	------------------------------------------------------------------------------
+		Licensing information can be found at the end of the file.
+	------------------------------------------------------------------------------
+
+	File:   convolution.h - v1.0
+	Author: Matthew Rosen
+
+	Summary:
+		FFT and uniformly partitioned overlap-save convolution, used to add
+		instrument body and room impulse responses to the dry plucked strings.
+
+	Revision history:
+		1.0		(10/18/2026)	initial release
+*/
+#ifndef __MAT320_CONVOLUTION_H
+#define __MAT320_CONVOLUTION_H
+
+// includes
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+// in place radix-2 complex FFT on split real/imaginary arrays
+struct FFT
+{
+	unsigned size;					// number of complex points (power of 2)
+	std::vector<unsigned> bitrev;	// bit reversed index of each point
+	std::vector<float> cosTable;	// cos(2 pi k / size) for k < size / 2
+	std::vector<float> sinTable;	// sin(2 pi k / size) for k < size / 2
+
+	explicit FFT(unsigned n) : size(n), bitrev(n), cosTable(n / 2), sinTable(n / 2)
+	{
+		unsigned bits = 0;
+		while ((1u << bits) < n)
+			++bits;
+
+		for (unsigned i = 0; i < n; ++i)
+		{
+			unsigned r = 0;
+			for (unsigned b = 0; b < bits; ++b)
+				r |= ((i >> b) & 1) << (bits - 1 - b);
+			bitrev[i] = r;
+		}
+
+		for (unsigned k = 0; k < n / 2; ++k)
+		{
+			double w = 2.0 * 3.14159265358979323846 * k / n;
+			cosTable[k] = static_cast<float>(std::cos(w));
+			sinTable[k] = static_cast<float>(std::sin(w));
+		}
+	}
+
+	// forward transform uses e^(-i w), inverse uses e^(+i w) and doesn't scale
+	void transform(float* re, float* im, bool inverse) const
+	{
+		for (unsigned i = 0; i < size; ++i)
+		{
+			unsigned j = bitrev[i];
+			if (j > i)
+			{
+				std::swap(re[i], re[j]);
+				std::swap(im[i], im[j]);
+			}
+		}
+
+		const float sign = inverse ? 1.f : -1.f;
+		for (unsigned len = 2; len <= size; len <<= 1)
+		{
+			const unsigned half = len / 2;
+			const unsigned step = size / len;
+			for (unsigned start = 0; start < size; start += len)
+			{
+				for (unsigned k = 0; k < half; ++k)
+				{
+					float wr = cosTable[k * step];
+					float wi = sign * sinTable[k * step];
+					unsigned a = start + k, b = a + half;
+					float tr = re[b] * wr - im[b] * wi;
+					float ti = re[b] * wi + im[b] * wr;
+					re[b] = re[a] - tr;
+					im[b] = im[a] - ti;
+					re[a] += tr;
+					im[a] += ti;
+				}
+			}
+		}
+	}
+};
+
+// FFT of real signals of size N using one complex FFT of size N / 2
+// spectra hold bins 0 to N / 2 (the rest are the complex conjugates)
+struct RealFFT
+{
+	unsigned size;				// number of real points
+	FFT half;					// complex FFT of size / 2
+	std::vector<float> wr, wi;	// e^(-2 pi i k / size) for k <= size / 2
+	mutable std::vector<float> zr, zi;	// scratch buffers
+
+	explicit RealFFT(unsigned n) : size(n), half(n / 2), wr(n / 2 + 1), wi(n / 2 + 1), zr(n / 2), zi(n / 2)
+	{
+		for (unsigned k = 0; k <= n / 2; ++k)
+		{
+			double w = 2.0 * 3.14159265358979323846 * k / n;
+			wr[k] = static_cast<float>(std::cos(w));
+			wi[k] = static_cast<float>(-std::sin(w));
+		}
+	}
+
+	// x has size points, re/im get size / 2 + 1 bins
+	void forward(const float* x, float* re, float* im) const
+	{
+		const unsigned m = size / 2;
+
+		// pack even samples as real and odd samples as imaginary
+		for (unsigned n = 0; n < m; ++n)
+		{
+			zr[n] = x[2 * n];
+			zi[n] = x[2 * n + 1];
+		}
+		half.transform(zr.data(), zi.data(), false);
+
+		// split into the spectra of the even and odd samples and combine
+		for (unsigned k = 0; k <= m; ++k)
+		{
+			unsigned a = k % m, b = (m - k) % m;
+			float er = 0.5f * (zr[a] + zr[b]), ei = 0.5f * (zi[a] - zi[b]);
+			float or_ = 0.5f * (zi[a] + zi[b]), oi = -0.5f * (zr[a] - zr[b]);
+			re[k] = er + wr[k] * or_ - wi[k] * oi;
+			im[k] = ei + wr[k] * oi + wi[k] * or_;
+		}
+	}
+
+	// re/im have size / 2 + 1 bins, x gets size points scaled by 1 / size
+	void inverse(const float* re, const float* im, float* x) const
+	{
+		const unsigned m = size / 2;
+
+		for (unsigned k = 0; k < m; ++k)
+		{
+			// even and odd spectra from the bin and its mirror
+			float er = 0.5f * (re[k] + re[m - k]), ei = 0.5f * (im[k] - im[m - k]);
+			float dr = 0.5f * (re[k] - re[m - k]), di = 0.5f * (im[k] + im[m - k]);
+			float or_ = dr * wr[k] + di * wi[k], oi = di * wr[k] - dr * wi[k];
+
+			// Z = E + i O
+			zr[k] = er - oi;
+			zi[k] = ei + or_;
+		}
+		half.transform(zr.data(), zi.data(), true);
+
+		const float scale = 1.f / static_cast<float>(m);
+		for (unsigned n = 0; n < m; ++n)
+		{
+			x[2 * n] = zr[n] * scale;
+			x[2 * n + 1] = zi[n] * scale;
+		}
+	}
+};
+
+// acc += x * h for count complex bins on split arrays (restrict lets the compiler vectorize it)
+static inline void complex_multiply_add(const float* __restrict xr, const float* __restrict xi,
+	const float* __restrict hr, const float* __restrict hi, float* __restrict ar, float* __restrict ai, unsigned count)
+{
+	for (unsigned k = 0; k < count; ++k)
+	{
+		ar[k] += xr[k] * hr[k] - xi[k] * hi[k];
+		ai[k] += xr[k] * hi[k] + xi[k] * hr[k];
+	}
+}
+
+// picks the partition size for an impulse response: about 64 partitions, between 256 and 4096 samples
+// larger partitions keep the cost per sample from growing with the impulse response, at the price of latency
+static unsigned convolution_block_size(size_t irLength)
+{
+	unsigned blockSize = 256;
+	while (blockSize < 4096 && blockSize * 64 < irLength)
+		blockSize *= 2;
+	return blockSize;
+}
+
+// uniformly partitioned overlap-save convolution
+// the impulse response is cut into blocks of B samples that are each convolved in the
+// frequency domain, so the cost per sample is one FFT pair per B samples plus one complex
+// multiply-add per partition. Latency is B samples.
+struct Convolver
+{
+	unsigned B;						// block (partition) size, also the latency
+	unsigned numParts;				// number of impulse response partitions
+	unsigned bins;					// B + 1 frequency bins per spectrum
+	RealFFT fft;					// real FFT of size 2B
+	std::vector<float> irRe, irIm;	// spectrum of each partition, numParts * bins
+	std::vector<float> fdlRe, fdlIm;	// frequency domain delay line of input spectra, numParts * bins
+	unsigned fdlPos;				// newest spectrum in the delay line
+	std::vector<float> input;		// last 2B input samples
+	std::vector<float> output;		// B output samples of the last block
+	std::vector<float> accRe, accIm;	// spectrum of the output block
+	std::vector<float> time;		// 2B samples of the inverse transform
+	unsigned fill;					// samples of the current block taken in
+
+	Convolver(const std::vector<float>& ir, unsigned blockSize = 512)
+		: B(blockSize), numParts(static_cast<unsigned>((ir.size() + blockSize - 1) / blockSize)), bins(blockSize + 1),
+		fft(2 * blockSize), fdlPos(0), input(2 * blockSize, 0.f), output(blockSize, 0.f),
+		accRe(bins), accIm(bins), time(2 * blockSize), fill(0)
+	{
+		if (numParts == 0)
+			numParts = 1;
+
+		irRe.assign(static_cast<size_t>(numParts) * bins, 0.f);
+		irIm.assign(static_cast<size_t>(numParts) * bins, 0.f);
+		fdlRe.assign(static_cast<size_t>(numParts) * bins, 0.f);
+		fdlIm.assign(static_cast<size_t>(numParts) * bins, 0.f);
+
+		// transform each zero padded partition of the impulse response
+		for (unsigned p = 0; p < numParts; ++p)
+		{
+			std::fill(time.begin(), time.end(), 0.f);
+			for (unsigned i = 0; i < B && p * B + i < ir.size(); ++i)
+				time[i] = ir[p * B + i];
+			fft.forward(time.data(), &irRe[p * bins], &irIm[p * bins]);
+		}
+	}
+
+	// convolves count samples, output is delayed by B samples
+	void process(const float* in, float* out, unsigned count)
+	{
+		for (unsigned i = 0; i < count; ++i)
+		{
+			input[B + fill] = in[i];
+			out[i] = output[fill];
+			if (++fill == B)
+			{
+				run_block();
+				fill = 0;
+			}
+		}
+	}
+
+private:
+	void run_block()
+	{
+		// newest input spectrum goes to the front of the delay line
+		fdlPos = (fdlPos + 1) % numParts;
+		fft.forward(input.data(), &fdlRe[fdlPos * bins], &fdlIm[fdlPos * bins]);
+
+		// multiply each partition with the input spectrum from p blocks ago
+		std::fill(accRe.begin(), accRe.end(), 0.f);
+		std::fill(accIm.begin(), accIm.end(), 0.f);
+		for (unsigned p = 0; p < numParts; ++p)
+		{
+			unsigned slot = (fdlPos + numParts - p) % numParts;
+			complex_multiply_add(&fdlRe[slot * bins], &fdlIm[slot * bins], &irRe[p * bins], &irIm[p * bins],
+				accRe.data(), accIm.data(), bins);
+		}
+
+		// the last B samples of the circular convolution are the valid output
+		fft.inverse(accRe.data(), accIm.data(), time.data());
+		std::copy(time.begin() + B, time.end(), output.begin());
+
+		// slide the input window
+		std::copy(input.begin() + B, input.end(), input.begin());
+	}
+};
+
+// direct form convolution, for comparison: out[n] = sum of ir[k] * in[n - k]
+// computes count outputs starting at sample first
+static void direct_convolve(const std::vector<float>& in, const std::vector<float>& ir, float* out, size_t first, size_t count)
+{
+	for (size_t n = first; n < first + count && n < in.size(); ++n)
+	{
+		float sum = 0.f;
+		size_t taps = std::min(ir.size(), n + 1);
+		for (size_t k = 0; k < taps; ++k)
+			sum += ir[k] * in[n - k];
+		out[n - first] = sum;
+	}
+}
+
+#endif //__MAT320_CONVOLUTION_H
+
+/*
+	------------------------------------------------------------------------------
+	This software is available under 2 licenses - you may choose the one you like.
+	------------------------------------------------------------------------------
+	ALTERNATIVE A - zlib license
+	Copyright (c) 2019 Matthew Rosen
+	This software is provided 'as-is', without any express or implied warranty.
+	In no event will the authors be held liable for any damages arising from
+	the use of this software.
+	Permission is granted to anyone to use this software for any purpose,
+	including commercial applications, and to alter it and redistribute it
+	freely, subject to the following restrictions:
+	  1. The origin of this software must not be misrepresented; you must not
+		 claim that you wrote the original software. If you use this software
+		 in a product, an acknowledgment in the product documentation would be
+		 appreciated but is not required.
+	  2. Altered source versions must be plainly marked as such, and must not
+		 be misrepresented as being the original software.
+	  3. This notice may not be removed or altered from any source distribution.
+	------------------------------------------------------------------------------
+	ALTERNATIVE B - Public Domain (www.unlicense.org)
+	This is free and unencumbered software released into the public domain.
+	Anyone is free to copy, modify, publish, use, compile, sell, or distribute this
+	software, either in source code form or as a compiled binary, for any purpose,
+	commercial or non-commercial, and by any means.
+	In jurisdictions that recognize copyright laws, the author or authors of this
+	software dedicate any and all copyright interest in the software to the public
+	domain. We make this dedication for the benefit of the public at large and to
+	the detriment of our heirs and successors. We intend this dedication to be an
+	overt act of relinquishment in perpetuity of all present and future rights to
+	this software under copyright law.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+	ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+	WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+	------------------------------------------------------------------------------
+*/
@@ -0,0 +1,172 @@
+/*
+	------------------------------------------------------------------------------
+		Licensing information can be found at the end of the file.
+	------------------------------------------------------------------------------
+
+	File:   denormals.h - v1.0
+	Author: Matthew Rosen
+
+	Summary:
+		Denormal safe rendering. Plucked strings decay toward zero forever, and
+		once their feedback loops reach subnormal values x86 float math can get
+		10 to 100 times slower. Three defenses are available: a scoped FTZ/DAZ
+		guard, flushing strings to zero once they're inaudible, and feeding a
+		tiny noise floor into the feedback loop. Counters report how many
+		subnormal values each render produced.
+
+	Revision history:
+		1.0		(10/18/2026)	initial release
+*/
+#ifndef __MAT320_DENORMALS_H
+#define __MAT320_DENORMALS_H
+
+// includes
+#include "filters.h"
+#include "song.h"
+#include <ostream>
+
+// MXCSR is only available with SSE
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	define DENORMAL_GUARD_MXCSR 1
+#	include <xmmintrin.h>
+#else
+#	define DENORMAL_GUARD_MXCSR 0
+#endif
+
+// scoped guard that turns on flush to zero (FTZ) and denormals are zero (DAZ) for the current thread
+// the previous floating point state is restored when the guard goes out of scope
+struct DenormalGuard
+{
+	unsigned saved;	// MXCSR before the guard
+	bool active;	// whether the guard changed MXCSR
+
+	explicit DenormalGuard(bool enable = true) : saved(0), active(false)
+	{
+#if DENORMAL_GUARD_MXCSR
+		if (enable)
+		{
+			saved = _mm_getcsr();
+			_mm_setcsr(saved | 0x8040);	// FTZ is bit 15, DAZ is bit 6
+			active = true;
+		}
+#else
+		(void)enable;
+#endif
+	}
+
+	~DenormalGuard()
+	{
+#if DENORMAL_GUARD_MXCSR
+		if (active)
+			_mm_setcsr(saved);
+#endif
+	}
+
+	DenormalGuard(const DenormalGuard&) = delete;
+	DenormalGuard& operator=(const DenormalGuard&) = delete;
+};
+
+// denormal safety settings for a render, and counters of what happened
+struct DenormalMode
+{
+	bool ftz;						// render with FTZ/DAZ on
+	float flushLevel;				// strings are flushed to zero below this level (0 to disable)
+	float noiseFloor;				// constant fed into each string's feedback loop (0 to disable)
+	bool count;						// count subnormal values (costs a scan of each string every block)
+
+	// statistics
+	unsigned long long subnormals;	// subnormal values produced
+	unsigned long long noteBlocks;	// blocks of notes rendered
+	unsigned long long subnormalNoteBlocks;	// blocks of notes that produced subnormal values
+	unsigned long long flushed;		// strings flushed to zero
+
+	DenormalMode() : ftz(false), flushLevel(0.f), noiseFloor(0.f), count(false),
+		subnormals(0), noteBlocks(0), subnormalNoteBlocks(0), flushed(0) {}
+
+	// the denormal safe mode: FTZ/DAZ and flushing strings below -200 dB, optionally with a -360 dB noise floor
+	static DenormalMode safe(bool noise = false)
+	{
+		DenormalMode mode;
+		mode.ftz = true;
+		mode.flushLevel = 1e-10f;
+		mode.noiseFloor = noise ? 1e-18f : 0.f;
+		return mode;
+	}
+
+	// sets up a note as it starts playing
+	void start(Note& note) const
+	{
+		if (noiseFloor > 0.f)
+			note.filter.set_noise_floor(noiseFloor);
+	}
+
+	// checks a note after it rendered samples in a block: counts subnormals and flushes it once it's inaudible
+	void finish(Note& note, unsigned samples)
+	{
+		if (count)
+		{
+			unsigned found = note.filter.count_subnormals(samples);
+			subnormals += found;
+			subnormalNoteBlocks += (found != 0);
+			++noteBlocks;
+		}
+
+		if (flushLevel > 0.f && !note.filter.is_silent() && note.filter.excited() && note.filter.loudness() < flushLevel)
+		{
+			note.filter.flush();
+			++flushed;
+		}
+	}
+
+	// prints the counters
+	void report(std::ostream& out) const
+	{
+		out << "denormals: " << (ftz ? "FTZ/DAZ on" : "FTZ/DAZ off") << ", flush below " << flushLevel << ", noise floor " << noiseFloor
+			<< ": " << flushed << " strings flushed";
+		if (count)
+			out << ", " << subnormals << " subnormal values in " << subnormalNoteBlocks << " of " << noteBlocks << " note blocks";
+		out << std::endl;
+	}
+};
+
+#endif //__MAT320_DENORMALS_H
+
+/*
+	------------------------------------------------------------------------------
+	This software is available under 2 licenses - you may choose the one you like.
+	------------------------------------------------------------------------------
+	ALTERNATIVE A - zlib license
+	Copyright (c) 2019 Matthew Rosen
+	This software is provided 'as-is', without any express or implied warranty.
+	In no event will the authors be held liable for any damages arising from
+	the use of this software.
+	Permission is granted to anyone to use this software for any purpose,
+	including commercial applications, and to alter it and redistribute it
+	freely, subject to the following restrictions:
+	  1. The origin of this software must not be misrepresented; you must not
+		 claim that you wrote the original software. If you use this software
+		 in a product, an acknowledgment in the product documentation would be
+		 appreciated but is not required.
+	  2. Altered source versions must be plainly marked as such, and must not
+		 be misrepresented as being the original software.
+	  3. This notice may not be removed or altered from any source distribution.
+	------------------------------------------------------------------------------
+	ALTERNATIVE B - Public Domain (www.unlicense.org)
+	This is free and unencumbered software released into the public domain.
+	Anyone is free to copy, modify, publish, use, compile, sell, or distribute this
+	software, either in source code form or as a compiled binary, for any purpose,
+	commercial or non-commercial, and by any means.
+	In jurisdictions that recognize copyright laws, the author or authors of this
+	software dedicate any and all copyright interest in the software to the public
+	domain. We make this dedication for the benefit of the public at large and to
+	the detriment of our heirs and successors. We intend this dedication to be an
+	overt act of relinquishment in perpetuity of all present and future rights to
+	this software under copyright law.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+	ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+	WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+	------------------------------------------------------------------------------
+*/
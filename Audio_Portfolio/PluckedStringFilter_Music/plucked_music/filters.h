@@ -11,14 +11,27 @@
 
 	Revision history:
 		1.0		(07/07/2019)	initial release
+		1.1		(10/18/2026)	ring buffer comb filter, block processing with SSE kernel
+		1.2		(10/18/2026)	PSF quality levels for CPU budgeted rendering
+		1.3		(10/18/2026)	denormal safety: noise floor, flushing silent strings, subnormal counts
+		1.4		(10/18/2026)	optional per string excitation noise generator
 */
 #ifndef __MAT320_FILTERS_H
 #define __MAT320_FILTERS_H
 
 // includes
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
-#include <queue>
+#include <vector>
+
+// SSE is used for block processing when available (always on x64)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	define PSF_SIMD 1
+#	include <emmintrin.h>
+#else
+#	define PSF_SIMD 0
+#endif
 
 // helper macros
 #define RAND_BETWEEN(min, max) (std::rand() % (max - min + 1) + min)
@@ -29,6 +42,12 @@
 extern const float PI_F;
 extern const unsigned RATE;
 
+// helper function to check if a float is subnormal (denormal): too small for a normal exponent, but not zero
+static inline bool is_subnormal(float x)
+{
+	return x != 0.f && std::abs(x) < 1.17549435e-38f;
+}
+
 // low pass filter
 struct LPF
 {
@@ -63,10 +82,10 @@ struct APF
 	float y1;	// delayed output sample
 
 	// ctor based off of a target frequency
-	APF(float d, float freq) : a(0.f), x1(0.f), y1(0.f)
+	APF(float d, float freq, float rate = static_cast<float>(RATE)) : a(0.f), x1(0.f), y1(0.f)
 	{
 		// calculate frequency in rad
-		float w = PI_F * freq / RATE;
+		float w = PI_F * freq / rate;
 		a = (std::sin((1.f - d) * (w))) / (std::sin((1.f + d) * (w)));
 	}
 
@@ -92,16 +111,13 @@ struct CF
 
 	float R;					// distance from unit circle
 	unsigned L;					// power of the comb
-	std::queue<float> buffer;	// delayed output samples
+	std::vector<float> buffer;	// delayed output samples, ring buffer of L samples
+	unsigned pos;				// position of y(t - L) in the ring buffer
 	float multVal;				// R^L
 
 
-	explicit CF(unsigned power, float RVal = 0.99985f) : R(RVal), L(power), buffer(), multVal(std::pow(R, L))
+	explicit CF(unsigned power, float RVal = 0.99985f) : R(RVal), L(std::max(power, 1u)), buffer(L, 0.f), pos(0), multVal(std::pow(R, L))
 	{
-		for (unsigned i = 0; i < L; ++i)
-		{
-			buffer.push(0.f);
-		}
 	}
 
 	CF& operator=(const CF&) = default;
@@ -110,19 +126,54 @@ struct CF
 	// inline to avoid instruction cache miss
 	inline float operator()(float next)
 	{
-		float out = next + multVal * buffer.front();
-		buffer.pop();
-
-		return out;
+		return next + multVal * buffer[pos];
 	}
 
-	// adds to the feedback
+	// adds to the feedback, replacing the sample that was just read
 	inline void feed_back(float out)
 	{
-		buffer.push(out);
+		buffer[pos] = out;
+		if (++pos == L)
+			pos = 0;
+	}
+
+	// most recent output sample fed back
+	float newest() const
+	{
+		return buffer[pos ? pos - 1 : L - 1];
+	}
+
+	// changes the power of the comb, stretching the delayed samples to fit
+	// used when the string changes sampling rate: the delay line always holds one period
+	void resize(unsigned power)
+	{
+		power = std::max(power, 1u);
+		std::vector<float> resized(power);
+		const float ratio = static_cast<float>(L) / static_cast<float>(power);
+		for (unsigned i = 0; i < power; ++i)
+		{
+			// line up the newest samples, then interpolate linearly between the old samples
+			float x = std::max(0.f, static_cast<float>(L - 1) - static_cast<float>(power - 1 - i) * ratio);
+			unsigned i0 = static_cast<unsigned>(x);
+			unsigned i1 = std::min(i0 + 1, L - 1);
+			float frac = x - static_cast<float>(i0);
+			resized[i] = (1.f - frac) * buffer[(pos + i0) % L] + frac * buffer[(pos + i1) % L];
+		}
+		buffer.swap(resized);
+		L = power;
+		pos = 0;
 	}
 };
 
+// quality levels of a plucked string filter, each cheaper than the one before
+enum PSFQuality
+{
+	psfFull,		// comb, lowpass and allpass filters
+	psfNoAllpass,	// skips the allpass filter, the fractional part of the tuning is lost
+	psfHalfRate,	// no allpass filter, runs at half the sampling rate and interpolates
+	psfQualityCount
+};
+
 // plucked string filter
 // in this project designed to only play one note and sustain it.
 struct PSF
@@ -141,13 +192,20 @@ private:
 	CF comb;			// comb filter
 	float sus;			// sustain duration
 	unsigned numSample;	// current sample index
+	PSFQuality level;	// quality level
+	float halfPrev;		// previous half rate sample, interpolated with the next one
+	bool halfOdd;		// whether the next output sample is the previous half rate sample itself
+	float noiseFloor;	// constant fed into the comb filter after the excitation, keeps the feedback out of the subnormal range
+	bool silent;		// whether the string was flushed to zero, silent strings aren't processed
+	unsigned noiseState;	// state of the string's own excitation noise generator, 0 uses rand()
 
 public:
 	float frequency;
 
 	PSF(float freq, float duration = 1.f, float RVal = 0.99985f) : D(static_cast<float>(RATE) / freq - 0.5f), lowpass(),
 		allpass(D - std::floor(D), freq),
-		comb(std::floor(D), RVal), sus(duration), numSample(0), frequency(freq)
+		comb(static_cast<unsigned>(std::floor(D)), RVal), sus(duration), numSample(0), level(psfFull), halfPrev(0.f), halfOdd(false),
+		noiseFloor(0.f), silent(false), noiseState(0), frequency(freq)
 	{
 
 	}
@@ -168,7 +226,7 @@ public:
 			short rangeBegin, rangeEnd, shortVal;
 			rangeBegin = -15000;
 			rangeEnd = 15000;
-			shortVal = RAND_BETWEEN(rangeBegin, rangeEnd);
+			shortVal = noiseState ? next_noise(rangeBegin, rangeEnd) : RAND_BETWEEN(rangeBegin, rangeEnd);
 			next = SHORT_TO_FLOAT(shortVal);
 		}
 		// else case, next input is zero
@@ -183,6 +241,288 @@ public:
 
 		return allOut;
 	}
+
+	// whether the excitation noise is over, only then can the quality level change
+	bool excited() const { return numSample >= 100 * static_cast<unsigned>(sus); }
+
+	// current quality level
+	PSFQuality quality() const { return level; }
+
+	// tuning error a quality level adds, in cents
+	// the loop delay should be RATE / frequency samples, cheaper levels round it
+	float tuning_error(PSFQuality target) const
+	{
+		const float period = static_cast<float>(RATE) / frequency;
+		if (target == psfNoAllpass)
+			return 1200.f * std::log2(period / (std::floor(D) + 0.5f));
+		if (target == psfHalfRate)
+			return 1200.f * std::abs(std::log2(0.5f * period / (static_cast<float>(half_power()) + 0.5f)));
+		return 0.f;
+	}
+
+	// rough output level: RMS of the period held in the comb filter delay line
+	float loudness() const
+	{
+		const unsigned stride = std::max(1u, comb.L / 16);
+		float sum = 0.f;
+		unsigned n = 0;
+		for (unsigned i = 0; i < comb.L; i += stride, ++n)
+			sum += comb.buffer[i] * comb.buffer[i];
+		return std::sqrt(sum / static_cast<float>(n));
+	}
+
+	// gives the string its own excitation noise generator, seeded with a nonzero seed (0 goes back to rand())
+	// the noise then doesn't depend on the order strings are processed in, so strings can be rendered on any thread
+	void set_noise_seed(unsigned seed) { noiseState = seed; }
+
+	// sets the noise floor fed into the feedback loop (0 to disable)
+	void set_noise_floor(float level) { noiseFloor = level; }
+
+	// whether the string was flushed
+	bool is_silent() const { return silent; }
+
+	// flushes the filter states to zero and stops processing, after the excitation only
+	// used when the string has decayed below anything audible, before it reaches the subnormal range
+	void flush()
+	{
+		if (!excited())
+			return;
+		std::fill(comb.buffer.begin(), comb.buffer.end(), 0.f);
+		lowpass.x1 = 0.f;
+		allpass.x1 = allpass.y1 = 0.f;
+		halfPrev = 0.f;
+		silent = true;
+	}
+
+	// counts subnormal values among the last count samples fed back and the filter states
+	unsigned count_subnormals(unsigned count) const
+	{
+		count = std::min(count, comb.L);
+		unsigned found = is_subnormal(lowpass.x1) + is_subnormal(allpass.x1) + is_subnormal(allpass.y1);
+		for (unsigned i = 0, j = comb.pos; i < count; ++i)
+		{
+			j = j ? j - 1 : comb.L - 1;
+			found += is_subnormal(comb.buffer[j]);
+		}
+		return found;
+	}
+
+	// changes the quality level, after the excitation only
+	// @return whether the level changed
+	bool set_quality(PSFQuality target)
+	{
+		if (target == level || !excited())
+			return false;
+
+		if (target == psfHalfRate)
+		{
+			comb.resize(half_power());
+			halfPrev = comb.newest();
+			halfOdd = false;
+		}
+		else if (level == psfHalfRate)
+		{
+			comb.resize(static_cast<unsigned>(std::floor(D)));
+		}
+
+		// the allpass filter picks up where the output left off
+		if (target == psfFull)
+			allpass.x1 = allpass.y1 = comb.newest();
+
+		level = target;
+		return true;
+	}
+
+	// block version of the sample operator: adds the next count samples to out
+	inline void process(float* out, unsigned count)
+	{
+		// flushed strings only add zeros
+		if (silent)
+		{
+			numSample += count;
+			return;
+		}
+
+		// excitation noise comes from rand() one sample at a time
+		const unsigned excitationEnd = 100 * static_cast<unsigned>(sus);
+		for (; count && numSample < excitationEnd; --count)
+			*out++ += (*this)();
+
+		if (level == psfFull)
+			render<true>(out, count);
+		else if (level == psfNoAllpass)
+			render<false>(out, count);
+		else
+			render_half(out, count);
+	}
+
+private:
+	// next value of the string's own noise generator (xorshift32) between min and max
+	inline short next_noise(short min, short max)
+	{
+		noiseState ^= noiseState << 13;
+		noiseState ^= noiseState >> 17;
+		noiseState ^= noiseState << 5;
+		return static_cast<short>(static_cast<int>(noiseState % static_cast<unsigned>(max - min + 1)) + min);
+	}
+
+	// comb filter power at half the sampling rate
+	unsigned half_power() const
+	{
+		float halfD = 0.5f * static_cast<float>(RATE) / frequency - 0.5f;
+		return std::max(1u, static_cast<unsigned>(halfD + 0.5f));
+	}
+
+	// one sample after the excitation, optionally skipping the allpass filter
+	template <bool Allpass>
+	inline float step()
+	{
+		++numSample;
+		float combOut = comb(noiseFloor);
+		float lowOut = lowpass(combOut);
+		float allOut = Allpass ? allpass(lowOut) : lowOut;
+		comb.feed_back(allOut);
+		return allOut;
+	}
+
+	// adds count samples after the excitation to out
+	// the comb filter reads its own output from L samples ago, so any run of samples that
+	// doesn't wrap the delay line is independent of the feedback and is computed 4 at a time
+	template <bool Allpass>
+	inline void render(float* out, unsigned count)
+	{
+#if PSF_SIMD
+		// allpass recurrence y(t) = b(t) - a * y(t - 1) unrolled over 4 samples:
+		// y = b + (-a) * (b shifted 1) + a^2 * (b shifted 2) + (-a)^3 * (b shifted 3) + [-a, a^2, -a^3, a^4] * y(t - 1)
+		const float a = allpass.a;
+		const __m128 combMult = _mm_set1_ps(comb.multVal);
+		const __m128 combIn = _mm_set1_ps(noiseFloor);
+		const __m128 lowMult = _mm_set1_ps(lowpass.multVal);
+		const __m128 allA = _mm_set1_ps(a);
+		const __m128 pow1 = _mm_set1_ps(-a);
+		const __m128 pow2 = _mm_set1_ps(a * a);
+		const __m128 pow3 = _mm_set1_ps(-a * a * a);
+		const __m128 feedback = _mm_set_ps(a * a * a * a, -a * a * a, a * a, -a);
+
+		while (count)
+		{
+			// samples until the delay line wraps
+			const unsigned n = std::min(count, comb.L - comb.pos);
+			float* delay = comb.buffer.data() + comb.pos;
+			float lowX1 = lowpass.x1, allX1 = allpass.x1, allY1 = allpass.y1;
+
+			unsigned i = 0;
+			for (; i + 4 <= n; i += 4)
+			{
+				// comb filter (input is the noise floor after the excitation)
+				__m128 c = _mm_add_ps(combIn, _mm_mul_ps(combMult, _mm_loadu_ps(delay + i)));
+
+				// lowpass filter with the previous comb output shifted in
+				__m128 cPrev = _mm_or_ps(_mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(c), 4)), _mm_set_ss(lowX1));
+				__m128 y = _mm_add_ps(_mm_mul_ps(lowMult, c), _mm_mul_ps(lowMult, cPrev));
+				lowX1 = _mm_cvtss_f32(_mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 3, 3)));
+
+				if (Allpass)
+				{
+					// allpass feedforward part
+					__m128 low = y;
+					__m128 lowPrev = _mm_or_ps(_mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(low), 4)), _mm_set_ss(allX1));
+					__m128 b = _mm_add_ps(_mm_mul_ps(allA, low), lowPrev);
+					allX1 = _mm_cvtss_f32(_mm_shuffle_ps(low, low, _MM_SHUFFLE(3, 3, 3, 3)));
+
+					// allpass feedback part
+					__m128i bi = _mm_castps_si128(b);
+					y = _mm_add_ps(b, _mm_mul_ps(pow1, _mm_castsi128_ps(_mm_slli_si128(bi, 4))));
+					y = _mm_add_ps(y, _mm_mul_ps(pow2, _mm_castsi128_ps(_mm_slli_si128(bi, 8))));
+					y = _mm_add_ps(y, _mm_mul_ps(pow3, _mm_castsi128_ps(_mm_slli_si128(bi, 12))));
+					y = _mm_add_ps(y, _mm_mul_ps(feedback, _mm_set1_ps(allY1)));
+					allY1 = _mm_cvtss_f32(_mm_shuffle_ps(y, y, _MM_SHUFFLE(3, 3, 3, 3)));
+				}
+
+				// feed back to the comb filter and add to the output
+				_mm_storeu_ps(delay + i, y);
+				_mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), y));
+			}
+
+			lowpass.x1 = lowX1;
+			allpass.x1 = allX1;
+			allpass.y1 = allY1;
+			numSample += i;
+			comb.pos += i;
+			if (comb.pos == comb.L)
+				comb.pos = 0;
+
+			// leftover samples before the wrap
+			for (; i < n; ++i)
+				out[i] += step<Allpass>();
+
+			out += n;
+			count -= n;
+		}
+#else
+		for (; count; --count)
+			*out++ += step<Allpass>();
+#endif
+	}
+
+	// adds count samples to out from the string running at half the sampling rate
+	// every other output sample is a new half rate sample, the ones between are interpolated
+	// (which delays the output by half a sample)
+	inline void render_half(float* out, unsigned count)
+	{
+		// half[0] holds the previous half rate sample, new ones follow it
+		float half[129];
+		const unsigned endSample = numSample + count;
+		while (count)
+		{
+			// the previous half rate sample is still due
+			if (halfOdd)
+			{
+				*out++ += halfPrev;
+				--count;
+				halfOdd = false;
+				continue;
+			}
+
+			// new half rate samples, 2 output samples each
+			const unsigned numHalf = std::min(128u, (count + 1) / 2);
+			const unsigned pairs = std::min(numHalf, count / 2);
+			half[0] = halfPrev;
+			std::fill(half + 1, half + 1 + numHalf, 0.f);
+			render<false>(half + 1, numHalf);
+
+			unsigned k = 0;
+#if PSF_SIMD
+			// interleave the interpolated samples with the half rate samples, 8 output samples at a time
+			const __m128 halfMult = _mm_set1_ps(0.5f);
+			for (; k + 4 <= pairs; k += 4)
+			{
+				__m128 h = _mm_loadu_ps(half + 1 + k);
+				__m128 mid = _mm_mul_ps(halfMult, _mm_add_ps(_mm_loadu_ps(half + k), h));
+				_mm_storeu_ps(out + 2 * k, _mm_add_ps(_mm_loadu_ps(out + 2 * k), _mm_unpacklo_ps(mid, h)));
+				_mm_storeu_ps(out + 2 * k + 4, _mm_add_ps(_mm_loadu_ps(out + 2 * k + 4), _mm_unpackhi_ps(mid, h)));
+			}
+#endif
+			for (; k < pairs; ++k)
+			{
+				out[2 * k] += 0.5f * (half[k] + half[k + 1]);
+				out[2 * k + 1] += half[k + 1];
+			}
+			halfPrev = half[pairs];
+
+			// odd count: the last half rate sample is interpolated now and output on its own next time
+			if (numHalf > pairs)
+			{
+				out[2 * pairs] += 0.5f * (halfPrev + half[numHalf]);
+				halfPrev = half[numHalf];
+				halfOdd = true;
+			}
+
+			out += 2 * pairs + (numHalf - pairs);
+			count -= 2 * pairs + (numHalf - pairs);
+		}
+		numSample = endSample;
+	}
 };
 
 #endif //__MAT320_FILTERS_H
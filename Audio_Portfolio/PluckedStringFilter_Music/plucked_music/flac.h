@@ -0,0 +1,868 @@
+/*
+	------------------------------------------------------------------------------
+		Licensing information can be found at the end of the file.
+	------------------------------------------------------------------------------
+
+	File:   flac.h - v1.0
+	Author: Matthew Rosen
+
+	Summary:
+		Streaming lossless encoder writing 16 bit mono FLAC files, and a
+		decoder used to verify them.
+		Each block is coded as a constant (silence), fixed or LPC subframe,
+		whichever is smallest, with a partitioned Rice coded residual.
+
+	Revision history:
+		1.0		(10/18/2026)	initial release
+*/
+#ifndef __MAT320_FLAC_H
+#define __MAT320_FLAC_H
+
+// includes
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+// FLAC constants
+const unsigned FLAC_BLOCK_SIZE = 4096;		// samples per frame (every frame but the last)
+const unsigned FLAC_MAX_LPC_ORDER = 8;		// highest LPC predictor order tried
+const unsigned FLAC_LPC_PRECISION = 12;		// bits per quantized LPC coefficient
+const unsigned FLAC_MAX_PARTITION_ORDER = 8;	// highest Rice partition order tried
+const unsigned FLAC_MAX_RICE_PARAM = 14;	// 4 bit Rice parameters, 15 is the escape code
+
+// CRC-8 (polynomial x^8 + x^2 + x + 1) used for frame headers
+static uint8_t flac_crc8(const uint8_t* data, size_t size)
+{
+	uint8_t crc = 0;
+	for (size_t i = 0; i < size; ++i)
+	{
+		crc ^= data[i];
+		for (int b = 0; b < 8; ++b)
+			crc = (crc & 0x80) ? static_cast<uint8_t>((crc << 1) ^ 0x07) : static_cast<uint8_t>(crc << 1);
+	}
+	return crc;
+}
+
+// CRC-16 (polynomial x^16 + x^15 + x^2 + 1) used for whole frames
+static uint16_t flac_crc16(const uint8_t* data, size_t size)
+{
+	uint16_t crc = 0;
+	for (size_t i = 0; i < size; ++i)
+	{
+		crc ^= static_cast<uint16_t>(data[i] << 8);
+		for (int b = 0; b < 8; ++b)
+			crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x8005) : static_cast<uint16_t>(crc << 1);
+	}
+	return crc;
+}
+
+// writes bits MSB first into a byte buffer
+struct BitWriter
+{
+	std::vector<uint8_t> bytes;	// finished bytes
+	uint64_t accum;				// bits not yet flushed to bytes
+	unsigned numBits;			// number of bits in accum
+
+	BitWriter() : bytes(), accum(0), numBits(0) {}
+
+	// write the low count bits of value (count <= 32)
+	inline void write(uint32_t value, unsigned count)
+	{
+		if (count == 0)
+			return;
+		accum = (accum << count) | (value & (0xFFFFFFFFull >> (32 - count)));
+		numBits += count;
+		while (numBits >= 8)
+		{
+			numBits -= 8;
+			bytes.push_back(static_cast<uint8_t>(accum >> numBits));
+		}
+	}
+
+	// write a signed value in count bits two's complement
+	inline void write_signed(int32_t value, unsigned count)
+	{
+		write(static_cast<uint32_t>(value), count);
+	}
+
+	// write a value as count zeros followed by a one
+	inline void write_unary(uint32_t count)
+	{
+		while (count >= 32)
+		{
+			write(0, 32);
+			count -= 32;
+		}
+		write(1, count + 1);
+	}
+
+	// pad with zeros to the next byte boundary
+	void align()
+	{
+		if (numBits)
+			write(0, 8 - numBits);
+	}
+
+	void clear()
+	{
+		bytes.clear();
+		accum = 0;
+		numBits = 0;
+	}
+};
+
+// reads bits MSB first out of a byte buffer
+struct BitReader
+{
+	const uint8_t* data;	// bytes to read
+	size_t size;			// number of bytes
+	size_t bitPos;			// current bit position
+
+	BitReader(const uint8_t* _data, size_t _size) : data(_data), size(_size), bitPos(0) {}
+
+	bool overrun() const { return bitPos > size * 8; }
+	size_t byte_pos() const { return bitPos / 8; }
+
+	// read count bits (count <= 32) as an unsigned value
+	inline uint32_t read(unsigned count)
+	{
+		uint32_t value = 0;
+		for (unsigned i = 0; i < count; ++i)
+		{
+			size_t byte = bitPos >> 3;
+			uint32_t bit = byte < size ? (data[byte] >> (7 - (bitPos & 7))) & 1 : 0;
+			value = (value << 1) | bit;
+			++bitPos;
+		}
+		return value;
+	}
+
+	// read count bits as a two's complement signed value
+	inline int32_t read_signed(unsigned count)
+	{
+		uint32_t value = read(count);
+		if (count && count < 32 && (value >> (count - 1)))
+			value |= ~0u << count;
+		return static_cast<int32_t>(value);
+	}
+
+	// read a unary coded value (number of zeros before a one)
+	inline uint32_t read_unary()
+	{
+		uint32_t count = 0;
+		while (!overrun() && read(1) == 0)
+			++count;
+		return count;
+	}
+
+	void align()
+	{
+		bitPos = (bitPos + 7) & ~static_cast<size_t>(7);
+	}
+};
+
+// maps a signed residual to the unsigned value that is Rice coded
+static inline uint32_t flac_zigzag(int32_t r)
+{
+	return (static_cast<uint32_t>(r) << 1) ^ static_cast<uint32_t>(r >> 31);
+}
+
+// number of bits needed to Rice code count values summing to sum with parameter k (estimate)
+static inline uint64_t flac_rice_bits(uint64_t sum, unsigned count, unsigned k)
+{
+	return static_cast<uint64_t>(count) * (k + 1) + (sum >> k);
+}
+
+// best Rice parameter for count values summing to sum
+static unsigned flac_best_rice_param(uint64_t sum, unsigned count, uint64_t* bits)
+{
+	unsigned best = 0;
+	uint64_t bestBits = flac_rice_bits(sum, count, 0);
+	for (unsigned k = 1; k <= FLAC_MAX_RICE_PARAM; ++k)
+	{
+		uint64_t b = flac_rice_bits(sum, count, k);
+		if (b < bestBits)
+		{
+			bestBits = b;
+			best = k;
+		}
+	}
+	*bits = bestBits;
+	return best;
+}
+
+// plan for coding a residual: partition order and one Rice parameter per partition
+struct RicePlan
+{
+	unsigned order;
+	unsigned params[1 << FLAC_MAX_PARTITION_ORDER];
+	uint64_t bits;
+};
+
+// chooses the partition order and Rice parameters that code a residual in the fewest bits
+// residual holds blockSize - predOrder values
+static void flac_plan_residual(const uint32_t* folded, unsigned blockSize, unsigned predOrder, RicePlan& plan)
+{
+	// find the deepest partition order this block allows
+	unsigned maxOrder = 0;
+	while (maxOrder < FLAC_MAX_PARTITION_ORDER && (blockSize % (2u << maxOrder)) == 0 &&
+		(blockSize >> (maxOrder + 1)) > predOrder)
+		++maxOrder;
+
+	// sums of the smallest partitions, merged pairwise for each lower order
+	uint64_t sums[1 << FLAC_MAX_PARTITION_ORDER];
+	unsigned numParts = 1u << maxOrder;
+	unsigned partSize = blockSize >> maxOrder;
+	unsigned r = 0;
+	for (unsigned p = 0; p < numParts; ++p)
+	{
+		unsigned count = (p == 0) ? partSize - predOrder : partSize;
+		uint64_t sum = 0;
+		for (unsigned i = 0; i < count; ++i)
+			sum += folded[r++];
+		sums[p] = sum;
+	}
+
+	plan.bits = ~0ull;
+	for (int order = static_cast<int>(maxOrder); order >= 0; --order)
+	{
+		unsigned parts = 1u << order;
+		unsigned size = blockSize >> order;
+		unsigned params[1 << FLAC_MAX_PARTITION_ORDER];
+		uint64_t total = 0;
+		for (unsigned p = 0; p < parts; ++p)
+		{
+			uint64_t bits;
+			unsigned count = (p == 0) ? size - predOrder : size;
+			params[p] = flac_best_rice_param(sums[p], count, &bits);
+			total += bits + 4;
+		}
+
+		if (total < plan.bits)
+		{
+			plan.bits = total;
+			plan.order = static_cast<unsigned>(order);
+			std::memcpy(plan.params, params, parts * sizeof(unsigned));
+		}
+
+		// merge partition sums for the next lower order
+		for (unsigned p = 0; p < parts / 2; ++p)
+			sums[p] = sums[2 * p] + sums[2 * p + 1];
+	}
+}
+
+// writes a residual using a plan from flac_plan_residual
+static void flac_write_residual(BitWriter& bw, const uint32_t* folded, unsigned blockSize, unsigned predOrder, const RicePlan& plan)
+{
+	bw.write(0, 2);					// coding method: 4 bit Rice parameters
+	bw.write(plan.order, 4);		// partition order
+
+	unsigned parts = 1u << plan.order;
+	unsigned size = blockSize >> plan.order;
+	unsigned r = 0;
+	for (unsigned p = 0; p < parts; ++p)
+	{
+		unsigned k = plan.params[p];
+		unsigned count = (p == 0) ? size - predOrder : size;
+		bw.write(k, 4);
+		for (unsigned i = 0; i < count; ++i)
+		{
+			uint32_t u = folded[r++];
+			bw.write_unary(u >> k);
+			bw.write(u, k);
+		}
+	}
+}
+
+// streaming FLAC encoder for 16 bit mono audio
+// usage: open, write samples as they are produced, close
+struct FlacEncoder
+{
+	std::fstream out;				// output file
+	unsigned rate;					// sampling rate written to STREAMINFO
+	std::vector<int32_t> block;		// samples waiting to be encoded
+	uint64_t totalSamples;			// samples encoded so far
+	uint64_t totalBytes;			// bytes written so far
+	unsigned frameNumber;			// index of the next frame
+	unsigned minFrameSize;			// smallest frame in bytes
+	unsigned maxFrameSize;			// largest frame in bytes
+	BitWriter frame;				// scratch buffer for the frame being encoded
+	std::vector<uint32_t> folded;	// scratch buffer for zigzagged residuals
+	std::vector<uint32_t> bestFolded;	// residual of the best predictor so far
+
+	FlacEncoder() : rate(0), totalSamples(0), totalBytes(0), frameNumber(0), minFrameSize(~0u), maxFrameSize(0) {}
+	~FlacEncoder() { close(); }
+
+	// open a file and write the stream header
+	// @return whether the file could be opened
+	bool open(const char* filename, unsigned sampleRate)
+	{
+		out.open(filename, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+		if (!out)
+			return false;
+
+		rate = sampleRate;
+		block.clear();
+		block.reserve(FLAC_BLOCK_SIZE);
+		folded.resize(FLAC_BLOCK_SIZE);
+		bestFolded.resize(FLAC_BLOCK_SIZE);
+		totalSamples = 0;
+		totalBytes = 0;
+		frameNumber = 0;
+		minFrameSize = ~0u;
+		maxFrameSize = 0;
+
+		write_stream_info();
+		return true;
+	}
+
+	// add samples to the stream, full blocks are encoded right away
+	void write(const short* samples, unsigned count)
+	{
+		for (unsigned i = 0; i < count; ++i)
+		{
+			block.push_back(samples[i]);
+			if (block.size() == FLAC_BLOCK_SIZE)
+				encode_block();
+		}
+	}
+
+	// encode the last partial block and patch the stream header with the final totals
+	void close()
+	{
+		if (!out.is_open())
+			return;
+
+		if (!block.empty())
+			encode_block();
+
+		write_stream_info();
+		out.close();
+	}
+
+private:
+	// writes the "fLaC" marker and STREAMINFO block at the start of the file
+	void write_stream_info()
+	{
+		BitWriter bw;
+		bw.write('f', 8); bw.write('L', 8); bw.write('a', 8); bw.write('C', 8);
+
+		bw.write(1, 1);						// last metadata block
+		bw.write(0, 7);						// STREAMINFO
+		bw.write(34, 24);					// block length
+		bw.write(FLAC_BLOCK_SIZE, 16);		// min block size
+		bw.write(FLAC_BLOCK_SIZE, 16);		// max block size
+		bw.write(maxFrameSize ? minFrameSize : 0, 24);
+		bw.write(maxFrameSize, 24);
+		bw.write(rate, 20);
+		bw.write(0, 3);						// channels - 1
+		bw.write(15, 5);					// bits per sample - 1
+		bw.write(static_cast<uint32_t>(totalSamples >> 32), 4);
+		bw.write(static_cast<uint32_t>(totalSamples), 32);
+		for (int i = 0; i < 4; ++i)
+			bw.write(0, 32);				// MD5 of the audio (0 = not computed)
+
+		std::streampos end = out.tellp();
+		out.seekp(0);
+		out.write(reinterpret_cast<const char*>(bw.bytes.data()), bw.bytes.size());
+		if (totalBytes == 0)
+			totalBytes = bw.bytes.size();
+		else
+			out.seekp(end);
+	}
+
+	// writes the frame number as UTF-8 style coded integer
+	static void write_utf8(BitWriter& bw, uint32_t value)
+	{
+		if (value < 0x80)
+		{
+			bw.write(value, 8);
+			return;
+		}
+
+		unsigned numBytes = 2;
+		while (numBytes < 6 && value >= (1u << (5 * numBytes + 1)))
+			++numBytes;
+
+		unsigned shift = 6 * (numBytes - 1);
+		bw.write((0xFF00u >> numBytes) | (value >> shift), 8);
+		while (shift)
+		{
+			shift -= 6;
+			bw.write(0x80 | ((value >> shift) & 0x3F), 8);
+		}
+	}
+
+	// computes the residual of a fixed polynomial predictor, returns the sum of zigzagged values
+	static uint64_t fixed_residual(const int32_t* x, unsigned n, unsigned order, uint32_t* out)
+	{
+		uint64_t sum = 0;
+		for (unsigned i = order; i < n; ++i)
+		{
+			int32_t r;
+			switch (order)
+			{
+			case 0: r = x[i]; break;
+			case 1: r = x[i] - x[i - 1]; break;
+			case 2: r = x[i] - 2 * x[i - 1] + x[i - 2]; break;
+			case 3: r = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3]; break;
+			default: r = x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4]; break;
+			}
+			uint32_t u = flac_zigzag(r);
+			out[i - order] = u;
+			sum += u;
+		}
+		return sum;
+	}
+
+	// computes quantized LPC coefficients of the given order using a Welch window and Levinson-Durbin
+	// @return false if the block can't be predicted (e.g. all zeros)
+	static bool compute_lpc(const int32_t* x, unsigned n, unsigned order, int32_t* qcoef, int* shift)
+	{
+		// windowed autocorrelation
+		std::vector<double> w(n);
+		double half = (n - 1) / 2.0;
+		for (unsigned i = 0; i < n; ++i)
+		{
+			double t = (i - half) / (half + 1.0);
+			w[i] = x[i] * (1.0 - t * t);
+		}
+
+		double autoc[FLAC_MAX_LPC_ORDER + 1];
+		for (unsigned lag = 0; lag <= order; ++lag)
+		{
+			double sum = 0.0;
+			for (unsigned i = lag; i < n; ++i)
+				sum += w[i] * w[i - lag];
+			autoc[lag] = sum;
+		}
+		if (autoc[0] <= 0.0)
+			return false;
+
+		// Levinson-Durbin recursion
+		double lpc[FLAC_MAX_LPC_ORDER] = { 0.0 };
+		double err = autoc[0];
+		for (unsigned i = 0; i < order; ++i)
+		{
+			double r = -autoc[i + 1];
+			for (unsigned j = 0; j < i; ++j)
+				r -= lpc[j] * autoc[i - j];
+			r /= err;
+
+			lpc[i] = r;
+			for (unsigned j = 0; j < i / 2; ++j)
+			{
+				double tmp = lpc[j];
+				lpc[j] += r * lpc[i - 1 - j];
+				lpc[i - 1 - j] += r * tmp;
+			}
+			if (i & 1)
+				lpc[i / 2] += lpc[i / 2] * r;
+
+			err *= (1.0 - r * r);
+			if (err <= 0.0)
+				return false;
+		}
+
+		// quantize the predictor coefficients (prediction is +sum, so negate)
+		double cmax = 0.0;
+		for (unsigned i = 0; i < order; ++i)
+			cmax = std::fmax(cmax, std::fabs(lpc[i]));
+		if (cmax <= 0.0)
+			return false;
+
+		int log2cmax;
+		std::frexp(cmax, &log2cmax);
+		int s = static_cast<int>(FLAC_LPC_PRECISION) - 1 - log2cmax;
+		if (s > 15) s = 15;
+		if (s < 0) return false;
+
+		const int32_t qmax = (1 << (FLAC_LPC_PRECISION - 1)) - 1;
+		double error = 0.0;
+		for (unsigned i = 0; i < order; ++i)
+		{
+			error += -lpc[i] * (1 << s);
+			long q = std::lround(error);
+			if (q > qmax) q = qmax;
+			if (q < -qmax - 1) q = -qmax - 1;
+			error -= q;
+			qcoef[i] = static_cast<int32_t>(q);
+		}
+		*shift = s;
+		return true;
+	}
+
+	// computes the residual of an LPC predictor, returns the sum of zigzagged values
+	static uint64_t lpc_residual(const int32_t* x, unsigned n, unsigned order, const int32_t* qcoef, int shift, uint32_t* out)
+	{
+		uint64_t sum = 0;
+		for (unsigned i = order; i < n; ++i)
+		{
+			int64_t pred = 0;
+			for (unsigned j = 0; j < order; ++j)
+				pred += static_cast<int64_t>(qcoef[j]) * x[i - j - 1];
+			int32_t r = x[i] - static_cast<int32_t>(pred >> shift);
+			uint32_t u = flac_zigzag(r);
+			out[i - order] = u;
+			sum += u;
+		}
+		return sum;
+	}
+
+	// encodes the buffered block as one frame
+	void encode_block()
+	{
+		const unsigned n = static_cast<unsigned>(block.size());
+		const int32_t* x = block.data();
+
+		frame.clear();
+
+		// frame header
+		frame.write(0xFFF8, 16);					// sync code, fixed block size stream
+		bool standardSize = (n == FLAC_BLOCK_SIZE);
+		frame.write(standardSize ? 12 : 7, 4);	// block size: 4096, or 16 bit size at the end of the header
+		frame.write(0, 4);						// sample rate from STREAMINFO
+		frame.write(0, 4);						// mono
+		frame.write(4, 3);						// 16 bits per sample
+		frame.write(0, 1);
+		write_utf8(frame, frameNumber);
+		if (!standardSize)
+			frame.write(n - 1, 16);
+		frame.write(flac_crc8(frame.bytes.data(), frame.bytes.size()), 8);
+
+		// case constant block (silence): 24 bits for the whole subframe
+		bool constant = true;
+		for (unsigned i = 1; i < n && constant; ++i)
+			constant = (x[i] == x[0]);
+
+		if (constant)
+		{
+			frame.write(0, 8);					// CONSTANT subframe
+			frame.write_signed(x[0], 16);
+		}
+		else
+		{
+			encode_subframe(x, n);
+		}
+
+		// frame footer
+		frame.align();
+		uint16_t crc = flac_crc16(frame.bytes.data(), frame.bytes.size());
+		frame.write(crc, 16);
+
+		out.write(reinterpret_cast<const char*>(frame.bytes.data()), frame.bytes.size());
+
+		unsigned frameSize = static_cast<unsigned>(frame.bytes.size());
+		if (frameSize < minFrameSize) minFrameSize = frameSize;
+		if (frameSize > maxFrameSize) maxFrameSize = frameSize;
+		totalBytes += frameSize;
+		totalSamples += n;
+		++frameNumber;
+		block.clear();
+	}
+
+	// picks the cheapest of verbatim, fixed and LPC prediction and writes the subframe
+	void encode_subframe(const int32_t* x, unsigned n)
+	{
+		// baseline: verbatim samples
+		uint64_t bestBits = 16ull * n;
+		int bestType = -1;				// -1 verbatim, 0 fixed, 1 LPC
+		unsigned bestOrder = 0;
+		RicePlan bestPlan = RicePlan(), plan;
+		int32_t qcoef[FLAC_MAX_LPC_ORDER];
+		int shift = 0;
+
+		// fixed predictors of orders 0 to 4
+		for (unsigned order = 0; order <= 4 && order < n; ++order)
+		{
+			fixed_residual(x, n, order, folded.data());
+			flac_plan_residual(folded.data(), n, order, plan);
+			uint64_t bits = 16ull * order + 6 + plan.bits;
+			if (bits < bestBits)
+			{
+				bestBits = bits;
+				bestType = 0;
+				bestOrder = order;
+				bestPlan = plan;
+				bestFolded.swap(folded);
+			}
+		}
+
+		// LPC predictor
+		unsigned lpcOrder = FLAC_MAX_LPC_ORDER;
+		if (n > 2 * lpcOrder && compute_lpc(x, n, lpcOrder, qcoef, &shift))
+		{
+			lpc_residual(x, n, lpcOrder, qcoef, shift, folded.data());
+			flac_plan_residual(folded.data(), n, lpcOrder, plan);
+			uint64_t bits = 16ull * lpcOrder + 4 + 5 + FLAC_LPC_PRECISION * lpcOrder + 6 + plan.bits;
+			if (bits < bestBits)
+			{
+				bestBits = bits;
+				bestType = 1;
+				bestOrder = lpcOrder;
+				bestPlan = plan;
+				bestFolded.swap(folded);
+			}
+		}
+
+		// subframe header: zero bit, 6 bit type, no wasted bits
+		if (bestType < 0)
+		{
+			frame.write(1 << 1, 8);				// VERBATIM
+			for (unsigned i = 0; i < n; ++i)
+				frame.write_signed(x[i], 16);
+			return;
+		}
+
+		if (bestType == 0)
+		{
+			frame.write((8 | bestOrder) << 1, 8);	// FIXED
+			for (unsigned i = 0; i < bestOrder; ++i)
+				frame.write_signed(x[i], 16);
+		}
+		else
+		{
+			frame.write((32 | (bestOrder - 1)) << 1, 8);	// LPC
+			for (unsigned i = 0; i < bestOrder; ++i)
+				frame.write_signed(x[i], 16);
+			frame.write(FLAC_LPC_PRECISION - 1, 4);
+			frame.write_signed(shift, 5);
+			for (unsigned i = 0; i < bestOrder; ++i)
+				frame.write_signed(qcoef[i], FLAC_LPC_PRECISION);
+		}
+		flac_write_residual(frame, bestFolded.data(), n, bestOrder, bestPlan);
+	}
+};
+
+// decodes a 16 bit mono FLAC file written by FlacEncoder (or any fixed block size encoder)
+// @param samples: filled with the decoded samples
+// @param sampleRate: filled with the sampling rate from STREAMINFO
+// @return false if the file is missing, not 16 bit mono FLAC, or a CRC doesn't match
+static bool flac_decode(const char* filename, std::vector<short>& samples, unsigned& sampleRate)
+{
+	std::ifstream in(filename, std::ios_base::binary);
+	if (!in)
+		return false;
+	std::vector<uint8_t> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+	if (file.size() < 42 || std::memcmp(file.data(), "fLaC", 4) != 0)
+		return false;
+
+	// metadata blocks
+	BitReader br(file.data(), file.size());
+	br.read(32);
+	uint64_t totalSamples = 0;
+	bool last = false;
+	while (!last)
+	{
+		last = br.read(1) != 0;
+		unsigned type = br.read(7);
+		unsigned length = br.read(24);
+		size_t next = br.byte_pos() + length;
+		if (type == 0)
+		{
+			br.read(16 + 16 + 24 + 24);
+			sampleRate = br.read(20);
+			unsigned channels = br.read(3) + 1;
+			unsigned bps = br.read(5) + 1;
+			totalSamples = static_cast<uint64_t>(br.read(4)) << 32;
+			totalSamples |= br.read(32);
+			if (channels != 1 || bps != 16)
+				return false;
+		}
+		br.bitPos = next * 8;
+		if (br.overrun())
+			return false;
+	}
+
+	samples.clear();
+	samples.reserve(static_cast<size_t>(totalSamples));
+	std::vector<int32_t> x;
+
+	// frames
+	while (br.byte_pos() + 2 < file.size())
+	{
+		size_t frameStart = br.byte_pos();
+		if (br.read(15) != 0x7FFC)
+			return false;
+		br.read(1);
+
+		unsigned sizeCode = br.read(4);
+		unsigned rateCode = br.read(4);
+		if (br.read(4) != 0)			// mono only
+			return false;
+		br.read(3 + 1);
+
+		// frame or sample number, UTF-8 style
+		uint32_t lead = br.read(8);
+		unsigned extra = 0;
+		while (extra < 7 && (lead & (0x80 >> extra)))
+			++extra;
+		for (unsigned i = 1; i < extra; ++i)
+			br.read(8);
+
+		unsigned n;
+		if (sizeCode == 1) n = 192;
+		else if (sizeCode >= 2 && sizeCode <= 5) n = 576u << (sizeCode - 2);
+		else if (sizeCode == 6) n = br.read(8) + 1;
+		else if (sizeCode == 7) n = br.read(16) + 1;
+		else if (sizeCode >= 8) n = 256u << (sizeCode - 8);
+		else return false;
+
+		if (rateCode == 12) br.read(8);
+		else if (rateCode == 13 || rateCode == 14) br.read(16);
+
+		size_t headerEnd = br.byte_pos();
+		if (br.read(8) != flac_crc8(file.data() + frameStart, headerEnd - frameStart))
+			return false;
+
+		// subframe
+		x.assign(n, 0);
+		br.read(1);
+		unsigned type = br.read(6);
+		if (br.read(1))				// wasted bits aren't written by FlacEncoder
+			return false;
+
+		if (type == 0)
+		{
+			int32_t v = br.read_signed(16);
+			for (unsigned i = 0; i < n; ++i)
+				x[i] = v;
+		}
+		else if (type == 1)
+		{
+			for (unsigned i = 0; i < n; ++i)
+				x[i] = br.read_signed(16);
+		}
+		else if ((type & 0x38) == 8 || (type & 0x20))
+		{
+			bool lpc = (type & 0x20) != 0;
+			unsigned order = lpc ? (type & 0x1F) + 1 : (type & 0x07);
+			if (order > n)
+				return false;
+			for (unsigned i = 0; i < order; ++i)
+				x[i] = br.read_signed(16);
+
+			int32_t qcoef[32];
+			int shift = 0;
+			if (lpc)
+			{
+				unsigned precision = br.read(4) + 1;
+				shift = br.read_signed(5);
+				for (unsigned i = 0; i < order; ++i)
+					qcoef[i] = br.read_signed(precision);
+				if (shift < 0)
+					return false;
+			}
+
+			// residual
+			unsigned method = br.read(2);
+			unsigned paramBits = method == 0 ? 4 : 5;
+			unsigned escape = method == 0 ? 15 : 31;
+			unsigned partOrder = br.read(4);
+			unsigned parts = 1u << partOrder;
+			unsigned i = order;
+			for (unsigned p = 0; p < parts; ++p)
+			{
+				unsigned count = (n >> partOrder) - (p == 0 ? order : 0);
+				unsigned k = br.read(paramBits);
+				unsigned rawBits = (k == escape) ? br.read(5) : 0;
+				for (unsigned j = 0; j < count; ++j, ++i)
+				{
+					if (k == escape)
+					{
+						x[i] = br.read_signed(rawBits);
+					}
+					else
+					{
+						uint32_t u = (br.read_unary() << k) | br.read(k);
+						x[i] = static_cast<int32_t>(u >> 1) ^ -static_cast<int32_t>(u & 1);
+					}
+				}
+			}
+
+			// undo prediction
+			for (unsigned t = order; t < n; ++t)
+			{
+				int64_t pred = 0;
+				if (lpc)
+				{
+					for (unsigned j = 0; j < order; ++j)
+						pred += static_cast<int64_t>(qcoef[j]) * x[t - j - 1];
+					pred >>= shift;
+				}
+				else
+				{
+					switch (order)
+					{
+					case 0: pred = 0; break;
+					case 1: pred = x[t - 1]; break;
+					case 2: pred = 2 * x[t - 1] - x[t - 2]; break;
+					case 3: pred = 3 * x[t - 1] - 3 * x[t - 2] + x[t - 3]; break;
+					default: pred = 4 * x[t - 1] - 6 * x[t - 2] + 4 * x[t - 3] - x[t - 4]; break;
+					}
+				}
+				x[t] += static_cast<int32_t>(pred);
+			}
+		}
+		else
+		{
+			return false;
+		}
+
+		// footer
+		br.align();
+		size_t frameEnd = br.byte_pos();
+		if (br.overrun() || br.read(16) != flac_crc16(file.data() + frameStart, frameEnd - frameStart))
+			return false;
+
+		for (unsigned i = 0; i < n; ++i)
+			samples.push_back(static_cast<short>(x[i]));
+	}
+
+	return samples.size() == totalSamples;
+}
+
+#endif //__MAT320_FLAC_H
+
+/*
+	------------------------------------------------------------------------------
+	This software is available under 2 licenses - you may choose the one you like.
+	------------------------------------------------------------------------------
+	ALTERNATIVE A - zlib license
+	Copyright (c) 2019 Matthew Rosen
+	This software is provided 'as-is', without any express or implied warranty.
+	In no event will the authors be held liable for any damages arising from
+	the use of this software.
+	Permission is granted to anyone to use this software for any purpose,
+	including commercial applications, and to alter it and redistribute it
+	freely, subject to the following restrictions:
+	  1. The origin of this software must not be misrepresented; you must not
+		 claim that you wrote the original software. If you use this software
+		 in a product, an acknowledgment in the product documentation would be
+		 appreciated but is not required.
+	  2. Altered source versions must be plainly marked as such, and must not
+		 be misrepresented as being the original software.
+	  3. This notice may not be removed or altered from any source distribution.
+	------------------------------------------------------------------------------
+	ALTERNATIVE B - Public Domain (www.unlicense.org)
+	This is free and unencumbered software released into the public domain.
+	Anyone is free to copy, modify, publish, use, compile, sell, or distribute this
+	software, either in source code form or as a compiled binary, for any purpose,
+	commercial or non-commercial, and by any means.
+	In jurisdictions that recognize copyright laws, the author or authors of this
+	software dedicate any and all copyright interest in the software to the public
+	domain. We make this dedication for the benefit of the public at large and to
+	the detriment of our heirs and successors. We intend this dedication to be an
+	overt act of relinquishment in perpetuity of all present and future rights to
+	this software under copyright law.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+	ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+	WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+	------------------------------------------------------------------------------
+*/
@@ -0,0 +1,368 @@
+/*
+	------------------------------------------------------------------------------
+		Licensing information can be found at the end of the file.
+	------------------------------------------------------------------------------
+
+	File:   midi.h - v1.0
+	Author: Matthew Rosen
+
+	Summary:
+		Standard MIDI File (format 0 and 1) importer.
+		Tracks are read in place, one event at a time, and merged in time order,
+		so tempo changes from any track apply to every track. Note on/off pairs
+		are turned straight into a flat timeline of notes in samples, sorted by
+		start time, ready for the renderer.
+
+	Revision history:
+		1.0		(10/18/2026)	initial release
+*/
+#ifndef __MAT320_MIDI_H
+#define __MAT320_MIDI_H
+
+// includes
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// global constants (defined in plucked_music.cpp)
+extern const unsigned RATE;
+
+// note in a MIDI timeline
+struct MidiNote
+{
+	unsigned startSample;	// first sample of the note
+	unsigned lengthSamples;	// number of samples the note is held for
+	unsigned char key;		// MIDI note number
+	unsigned char velocity;	// note on velocity
+	unsigned char channel;	// MIDI channel (0 to 15)
+	bool sustain;			// whether the note is held for longer than a beat
+
+	bool operator<(const MidiNote& rhs) const { return startSample < rhs.startSample; }
+};
+
+// notes of a MIDI file in time order, and what was found in it
+struct MidiTimeline
+{
+	std::vector<MidiNote> notes;	// notes sorted by start sample
+	unsigned format;				// SMF format (0 or 1)
+	unsigned tracks;				// number of tracks
+	unsigned tempoChanges;			// number of tempo events
+	unsigned events;				// number of events read
+	unsigned lengthSamples;			// end of the last event or note
+	std::string error;				// what went wrong if the file couldn't be read
+
+	MidiTimeline() : format(0), tracks(0), tempoChanges(0), events(0), lengthSamples(0) {}
+};
+
+// helper function to convert a MIDI note number to a frequency
+static float midi_to_frequency(int key)
+{
+	return 440.f * std::pow(2.f, static_cast<float>(key - 69) / 12.f);
+}
+
+// reads events of one track in place
+struct MidiTrackReader
+{
+	const unsigned char* pos;	// next byte
+	const unsigned char* end;	// end of the track chunk
+	unsigned long long tick;	// absolute time of the next event in ticks
+	unsigned char status;		// running status
+	bool done;					// whether the track has no events left
+
+	MidiTrackReader(const unsigned char* begin, const unsigned char* _end) : pos(begin), end(_end), tick(0), status(0), done(false)
+	{
+		read_delta();
+	}
+
+	// reads a variable length quantity
+	bool read_vlq(unsigned& value)
+	{
+		value = 0;
+		for (int i = 0; i < 4; ++i)
+		{
+			if (pos >= end)
+				return false;
+			unsigned char byte = *pos++;
+			value = (value << 7) | (byte & 0x7F);
+			if (!(byte & 0x80))
+				return true;
+		}
+		return false;
+	}
+
+	// reads the delta time in front of the next event
+	// the track is done if it ends before the delta, or right after it (truncated files)
+	void read_delta()
+	{
+		unsigned delta = 0;
+		if (pos >= end || !read_vlq(delta) || pos >= end)
+			done = true;
+		else
+			tick += delta;
+	}
+};
+
+// parses a Standard MIDI File held in memory into a timeline
+// @param skipDrums: ignore channel 10, which is percussion in General MIDI
+// @return false if the file isn't a format 0 or 1 MIDI file, with timeline.error set
+static bool parse_midi(const unsigned char* data, size_t size, MidiTimeline& timeline, bool skipDrums = true)
+{
+	timeline = MidiTimeline();
+
+	auto read16 = [](const unsigned char* p) { return static_cast<unsigned>(p[0] << 8 | p[1]); };
+	auto read32 = [](const unsigned char* p) { return static_cast<unsigned>(p[0]) << 24 | static_cast<unsigned>(p[1]) << 16 | static_cast<unsigned>(p[2]) << 8 | p[3]; };
+
+	// header chunk
+	if (size < 14 || std::string(reinterpret_cast<const char*>(data), 4) != "MThd" || read32(data + 4) < 6)
+	{
+		timeline.error = "not a MIDI file";
+		return false;
+	}
+	timeline.format = read16(data + 8);
+	unsigned numTracks = read16(data + 10);
+	unsigned division = read16(data + 12);
+	if (timeline.format > 1)
+	{
+		timeline.error = "format 2 MIDI files aren't supported";
+		return false;
+	}
+	if (division == 0)
+	{
+		timeline.error = "invalid time division";
+		return false;
+	}
+
+	// find the track chunks, skipping unknown chunks
+	std::vector<MidiTrackReader> readers;
+	size_t offset = 8 + read32(data + 4);
+	while (offset + 8 <= size && readers.size() < numTracks)
+	{
+		size_t length = read32(data + offset + 4);
+		const unsigned char* begin = data + offset + 8;
+		const unsigned char* end = data + std::min(size, offset + 8 + length);
+		if (std::string(reinterpret_cast<const char*>(data + offset), 4) == "MTrk")
+			readers.emplace_back(begin, end);
+		offset += 8 + length;
+	}
+	timeline.tracks = static_cast<unsigned>(readers.size());
+
+	// tick to seconds: a tempo in microseconds per quarter note, or SMPTE frames
+	double secondsPerTick = 0.5 / division;	// 120 bpm until the first tempo event
+	const bool smpte = (division & 0x8000) != 0;
+	if (smpte)
+	{
+		int fps = -static_cast<int>(static_cast<signed char>(division >> 8));
+		double framesPerSecond = (fps == 29) ? 29.97 : fps;
+		secondsPerTick = 1.0 / (framesPerSecond * (division & 0xFF));
+	}
+	const unsigned beatTicks = smpte ? static_cast<unsigned>(0.5 / secondsPerTick) : division;
+
+	unsigned long long currentTick = 0;
+	double currentSeconds = 0.0;
+
+	// notes held down on each channel and key: their start times in seconds, start ticks and velocities
+	struct Held { double seconds; unsigned long long tick; unsigned char velocity; };
+	std::vector<std::vector<Held>> held(16 * 128);
+
+	auto to_sample = [](double seconds) { return static_cast<unsigned>(std::floor(seconds * RATE + 0.5)); };
+	auto release = [&](unsigned channel, unsigned key)
+	{
+		std::vector<Held>& stack = held[channel * 128 + key];
+		if (stack.empty())
+			return;
+
+		// the first note on is the first to be released
+		Held h = stack.front();
+		stack.erase(stack.begin());
+
+		MidiNote note;
+		note.startSample = to_sample(h.seconds);
+		note.lengthSamples = std::max(1u, to_sample(currentSeconds) - note.startSample);
+		note.key = static_cast<unsigned char>(key);
+		note.velocity = h.velocity;
+		note.channel = static_cast<unsigned char>(channel);
+		note.sustain = currentTick - h.tick > beatTicks;
+		timeline.notes.push_back(note);
+	};
+
+	// merge the tracks: always read the earliest event next, earlier tracks first on ties
+	for (;;)
+	{
+		MidiTrackReader* track = nullptr;
+		for (MidiTrackReader& reader : readers)
+		{
+			if (!reader.done && (!track || reader.tick < track->tick))
+				track = &reader;
+		}
+		if (!track)
+			break;
+
+		// advance time
+		if (!smpte)
+			currentSeconds += static_cast<double>(track->tick - currentTick) * secondsPerTick;
+		else
+			currentSeconds = static_cast<double>(track->tick) * secondsPerTick;
+		currentTick = track->tick;
+		++timeline.events;
+
+		// read the status byte, or reuse the running status
+		const unsigned char*& p = track->pos;
+		unsigned char status = *p;
+		if (status & 0x80)
+			++p;
+		else if (track->status)
+			status = track->status;
+		else
+		{
+			timeline.error = "data byte without a status";
+			return false;
+		}
+
+		if (status == 0xFF)
+		{
+			// meta event
+			if (p >= track->end)
+			{
+				track->done = true;
+				continue;
+			}
+			unsigned char type = *p++;
+			unsigned length = 0;
+			if (!track->read_vlq(length) || static_cast<size_t>(track->end - p) < length)
+			{
+				track->done = true;
+				continue;
+			}
+			if (type == 0x51 && length == 3 && !smpte)
+			{
+				unsigned tempo = static_cast<unsigned>(p[0]) << 16 | static_cast<unsigned>(p[1]) << 8 | p[2];
+				secondsPerTick = tempo / (1.0e6 * division);
+				++timeline.tempoChanges;
+			}
+			p += length;
+			if (type == 0x2F)
+			{
+				track->done = true;
+				continue;
+			}
+		}
+		else if (status == 0xF0 || status == 0xF7)
+		{
+			// system exclusive, skipped
+			unsigned length = 0;
+			if (!track->read_vlq(length) || static_cast<size_t>(track->end - p) < length)
+			{
+				track->done = true;
+				continue;
+			}
+			p += length;
+		}
+		else if (status >= 0x80 && status < 0xF0)
+		{
+			// channel message: program change and channel pressure have one data byte, the rest have two
+			track->status = status;
+			unsigned numData = (status & 0xE0) == 0xC0 ? 1 : 2;
+			if (static_cast<size_t>(track->end - p) < numData)
+			{
+				track->done = true;
+				continue;
+			}
+			unsigned channel = status & 0x0F;
+			unsigned char type = status & 0xF0;
+			unsigned key = p[0] & 0x7F;
+			unsigned char velocity = numData > 1 ? (p[1] & 0x7F) : 0;
+			p += numData;
+
+			if (skipDrums && channel == 9)
+				;
+			else if (type == 0x90 && velocity > 0)
+				held[channel * 128 + key].push_back({ currentSeconds, currentTick, velocity });
+			else if (type == 0x80 || type == 0x90)
+				release(channel, key);
+		}
+		else
+		{
+			// system common and real time messages don't belong in files
+			timeline.error = "unexpected status byte";
+			return false;
+		}
+
+		track->read_delta();
+	}
+
+	// notes never released end with the file
+	for (unsigned i = 0; i < held.size(); ++i)
+	{
+		while (!held[i].empty())
+			release(i / 128, i % 128);
+	}
+
+	// note offs come in end order, the renderer wants start order
+	std::stable_sort(timeline.notes.begin(), timeline.notes.end());
+
+	timeline.lengthSamples = to_sample(currentSeconds);
+	for (const MidiNote& note : timeline.notes)
+		timeline.lengthSamples = std::max(timeline.lengthSamples, note.startSample + note.lengthSamples);
+
+	return true;
+}
+
+// reads a Standard MIDI File into a timeline
+// @return false if the file is missing or isn't a format 0 or 1 MIDI file, with timeline.error set
+static bool read_midi(const char* filename, MidiTimeline& timeline, bool skipDrums = true)
+{
+	std::ifstream in(filename, std::ios_base::binary);
+	if (!in)
+	{
+		timeline = MidiTimeline();
+		timeline.error = "couldn't open the file";
+		return false;
+	}
+	std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	return parse_midi(bytes.data(), bytes.size(), timeline, skipDrums);
+}
+
+#endif //__MAT320_MIDI_H
+
+/*
+	------------------------------------------------------------------------------
+	This software is available under 2 licenses - you may choose the one you like.
+	------------------------------------------------------------------------------
+	ALTERNATIVE A - zlib license
+	Copyright (c) 2019 Matthew Rosen
+	This software is provided 'as-is', without any express or implied warranty.
+	In no event will the authors be held liable for any damages arising from
+	the use of this software.
+	Permission is granted to anyone to use this software for any purpose,
+	including commercial applications, and to alter it and redistribute it
+	freely, subject to the following restrictions:
+	  1. The origin of this software must not be misrepresented; you must not
+		 claim that you wrote the original software. If you use this software
+		 in a product, an acknowledgment in the product documentation would be
+		 appreciated but is not required.
+	  2. Altered source versions must be plainly marked as such, and must not
+		 be misrepresented as being the original software.
+	  3. This notice may not be removed or altered from any source distribution.
+	------------------------------------------------------------------------------
+	ALTERNATIVE B - Public Domain (www.unlicense.org)
+	This is free and unencumbered software released into the public domain.
+	Anyone is free to copy, modify, publish, use, compile, sell, or distribute this
+	software, either in source code form or as a compiled binary, for any purpose,
+	commercial or non-commercial, and by any means.
+	In jurisdictions that recognize copyright laws, the author or authors of this
+	software dedicate any and all copyright interest in the software to the public
+	domain. We make this dedication for the benefit of the public at large and to
+	the detriment of our heirs and successors. We intend this dedication to be an
+	overt act of relinquishment in perpetuity of all present and future rights to
+	this software under copyright law.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+	ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+	WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+	------------------------------------------------------------------------------
+*/
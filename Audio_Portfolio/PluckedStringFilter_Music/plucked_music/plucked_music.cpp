@@ -12,13 +12,34 @@
 
 	Revision history:
 		1.0		(07/07/2019)	initial release
+		1.1		(10/18/2026)	song types moved to song.h, added song generator and benchmarks
+		1.2		(10/18/2026)	added lossless FLAC output
+		1.3		(10/18/2026)	block rendering using the PSF block kernel
+		1.4		(10/18/2026)	body/room impulse response convolution
+		1.5		(10/18/2026)	resampled output at other sampling rates
+		1.6		(10/18/2026)	CPU budgeted rendering with PSF quality levels
+		1.7		(10/18/2026)	denormal safe rendering
+		1.8		(10/18/2026)	parallel rendering of time segments from filter state checkpoints
+		1.9		(10/18/2026)	MIDI file input
 */
 
 // includes
 #include "filters.h"
+#include "convolution.h"
+#include "denormals.h"
+#include "flac.h"
+#include "midi.h"
+#include "render_budget.h"
+#include "resampler.h"
+#include "song.h"
+#include "song_generator.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <thread>
 #include <cmath>
 #include <vector>
 
@@ -38,22 +59,24 @@ const float QUARTER_NOTE = 0.28818443f;			// number of seconds that a quarter no
 const float HALF_NOTE = QUARTER_NOTE * 2.f;		// number of seconds for a half note
 const float EIGHTH_NOTE = QUARTER_NOTE / 2.f;	// number of seconds for an eighth note
 const float SUS_NOTE = 0.9999999f;				// contant used to make the plucked string filter sustain for longer
+const unsigned BLOCK_SIZE = 256;				// number of samples each note renders at a time
 
 // AudioData holds raw audio samples
-// Hardcoded to use 16 bit samples and 44.1 kHz output
+// Hardcoded to use 16 bit samples, songs are rendered at RATE and may be resampled for output
 struct AudioData
 {
 	std::vector<float> data;
+	unsigned sampleRate;
 
-	AudioData() : data(0) {}
-	float rate() const { return static_cast<float>(RATE); }
+	AudioData() : data(0), sampleRate(RATE) {}
+	float rate() const { return static_cast<float>(sampleRate); }
 	unsigned size_in_bytes() const { return static_cast<unsigned>(data.size()) * sizeof(short); }
 	unsigned num_samples() const { return static_cast<unsigned>(data.size()); }
 	short bits_per_sample() const { return 16; }
 };
 
 // helper function to write the header of a wave file to a file
-static void write_header(std::fstream& output, unsigned sizeInBytes)
+static void write_header(std::fstream& output, unsigned sizeInBytes, unsigned sampleRate)
 {
 	// define an anonymous struct to encompass the data
 	struct {
@@ -75,7 +98,7 @@ static void write_header(std::fstream& output, unsigned sizeInBytes)
 			   36 + sizeInBytes,
 			   {'W','A','V','E'},
 			   {'f','m','t',' '},
-			   16,1,1,RATE,sizeof(short) * RATE,2,16,
+			   16,1,1,sampleRate,static_cast<unsigned>(sizeof(short)) * sampleRate,2,16,
 			   {'d','a','t','a'},
 			   sizeInBytes
 	};
@@ -122,7 +145,7 @@ static void write_wave(const char* filename, const AudioData& data)
 	}
 
 	// write the header information of the wave file
-	write_header(out, data.size_in_bytes());
+	write_header(out, data.size_in_bytes(), data.sampleRate);
 
 	// write the wave file data chunk
 	out.write(reinterpret_cast<char*>(outData), data.size_in_bytes());
@@ -131,201 +154,1093 @@ static void write_wave(const char* filename, const AudioData& data)
 	delete[] outData;
 }
 
-// helper function to convert a given note to a frequency
-// @param noteName: a string with either 1 or 2 characters. "<Note letter><modifier>", e.g. Eb for "E flat"
-// @param octave:   integer octave number for the note to be in. Values should range from -1 to 7.
-// @return the given note's frequency in Hz
-static float note_to_frequency(const std::string& noteName, int octave)
+// read a .wav file into floating pt samples, averaging channels down to mono
+// supports 8, 16, 24 and 32 bit PCM and 32 bit float
+// @return false if the file is missing or in an unsupported format
+static bool read_wave(const char* filename, std::vector<float>& samples, unsigned& rate)
 {
-	const float baseFreq = 440.f;
-	float modifier = 0;
-	char noteChar = 0;
-
-	// extract a modifier if it exists (modifier is 1 if note is sharp or -1 if note is flat, 0 otherwise)
-	if (noteName.size() > 1)
-	{
-		char modChar = noteName[1];
-		if (modChar == 'b')
-			modifier = -1.f;
-		else if (modChar == 's' || modChar == '#')
-			modifier = 1.f;
-	}
-
-	// extract the note letter
-	if (noteName.size() >= 1)
-	{
-		noteChar = noteName.front();
-	}
-
-	// verify note letter and octave are valid
-	if (noteChar < 'A' || noteChar > 'G' || octave < -1 || octave > 7)
-		return -1.f; // error with the note
-
-	float noteVal = 0.f; // noteVal is the half-step increment from A
-
-	// determine the half-step increment from A
-	switch (noteChar)
-	{
-	case 'A':
-		noteVal = 0;
-		break;
-	case 'B':
-		noteVal = 2.f; // half steps away from A
-		break;
-	case 'C':
-		noteVal = 3.f; // half steps away from A
-		break;
-	case 'D':
-		noteVal = 5.f; // half steps away from A
-		break;
-	case 'E':
-		noteVal = 7.f; // half steps away from A
-		break;
-	case 'F':
-		noteVal = 8.f; // half steps away from A
-		break;
-	case 'G':
-		noteVal = 10.f; // half steps away from A
-		break;
-	// default case guaranteed to never be hit
-	}
-
-	// calculate the frequency without octave modification using the sharp/flat modifier from above
-	float freq = baseFreq * std::pow(2.f, (noteVal + modifier) / 12.f);
-
-	// modify octave value based on if note is below a C (A and B are in the octave below)
-	// modification is because base frequency is in octave 3
-	if (noteVal < 3.f) octave -= 4;
-	else octave -= 5;
-
-	// convert to frequency multiplier
-	float octaveMult = std::pow(2.f, octave);
-
-	return freq * octaveMult;
+	std::ifstream in(filename, std::ios_base::binary);
+	if (!in)
+		return false;
+	std::vector<unsigned char> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	if (file.size() < 12 || std::memcmp(file.data(), "RIFF", 4) != 0 || std::memcmp(file.data() + 8, "WAVE", 4) != 0)
+		return false;
+
+	auto read16 = [&](size_t at) { return static_cast<unsigned>(file[at] | (file[at + 1] << 8)); };
+	auto read32 = [&](size_t at) { return read16(at) | (read16(at + 2) << 16); };
+
+	unsigned format = 0, channels = 0, bits = 0;
+	size_t pos = 12;
+	while (pos + 8 <= file.size())
+	{
+		unsigned chunkSize = read32(pos + 4);
+		size_t body = pos + 8;
+		if (body + chunkSize > file.size())
+			chunkSize = static_cast<unsigned>(file.size() - body);
+
+		// format chunk, WAVE_FORMAT_EXTENSIBLE keeps the real format at the start of the sub format
+		if (std::memcmp(&file[pos], "fmt ", 4) == 0 && chunkSize >= 16)
+		{
+			format = read16(body);
+			channels = read16(body + 2);
+			rate = read32(body + 4);
+			bits = read16(body + 14);
+			if (format == 0xFFFE && chunkSize >= 26)
+				format = read16(body + 24);
+		}
+		// data chunk
+		else if (std::memcmp(&file[pos], "data", 4) == 0 && channels)
+		{
+			unsigned bytes = bits / 8;
+			if (!bytes || (format != 1 && !(format == 3 && bits == 32)))
+				return false;
+
+			size_t frames = chunkSize / (bytes * channels);
+			samples.assign(frames, 0.f);
+			for (size_t f = 0; f < frames; ++f)
+			{
+				float sum = 0.f;
+				for (unsigned c = 0; c < channels; ++c)
+				{
+					size_t at = body + (f * channels + c) * bytes;
+					float value;
+					if (format == 3)
+					{
+						unsigned raw = read32(at);
+						std::memcpy(&value, &raw, sizeof(float));
+					}
+					else if (bits == 8)
+						value = (static_cast<int>(file[at]) - 128) / 128.f;
+					else if (bits == 16)
+						value = static_cast<short>(read16(at)) / 32768.f;
+					else if (bits == 24)
+						value = static_cast<int>((file[at] << 8) | (file[at + 1] << 16) | (static_cast<unsigned>(file[at + 2]) << 24)) / 2147483648.f;
+					else
+						value = static_cast<int>(read32(at)) / 2147483648.f;
+					sum += value;
+				}
+				samples[f] = sum / static_cast<float>(channels);
+			}
+			return true;
+		}
+
+		pos = body + chunkSize + (chunkSize & 1);
+	}
+	return false;
 }
 
-// ease of use with defining a song
-#define N(n, o) note_to_frequency(#n, o)
-#define NOTE(note, octave, ...) Note(N(note, octave), __VA_ARGS__)
-#define MEASURE(...) {{}, { __VA_ARGS__ }}
+// adds an instrument body or room to the song by convolving it with an impulse response
+// the impulse response is scaled to unit energy, the tail of the reverb is added to the end of the song
+// @param wet: amount of the convolved signal mixed with the dry signal (0 to 1)
+static void apply_reverb(AudioData& data, std::vector<float> ir, float wet)
+{
+	double energy = 0.0;
+	for (float h : ir)
+		energy += static_cast<double>(h) * h;
+	if (energy <= 0.0)
+		return;
+	for (float& h : ir)
+		h /= static_cast<float>(std::sqrt(energy));
+
+	Convolver convolver(ir, convolution_block_size(ir.size()));
+	const unsigned latency = convolver.B;
+	const unsigned dryLength = data.num_samples();
+	const unsigned wetLength = dryLength + static_cast<unsigned>(ir.size()) - 1;
+	data.data.resize(wetLength, 0.f);
+
+	// convolve a block at a time, feeding silence after the end of the song to get the tail
+	std::vector<float> in(BLOCK_SIZE), out(BLOCK_SIZE);
+	unsigned written = 0;
+	for (unsigned i = 0; written < wetLength; i += BLOCK_SIZE)
+	{
+		for (unsigned j = 0; j < BLOCK_SIZE; ++j)
+			in[j] = (i + j < dryLength) ? data.data[i + j] : 0.f;
+		convolver.process(in.data(), out.data(), BLOCK_SIZE);
+
+		// output is delayed by the latency of the convolver
+		for (unsigned j = 0; j < BLOCK_SIZE; ++j)
+		{
+			if (i + j < latency || written >= wetLength)
+				continue;
+			float dry = written < dryLength ? data.data[written] : 0.f;
+			data.data[written] = (1.f - wet) * dry + wet * out[j];
+			++written;
+		}
+	}
+}
 
-// note within a song definition
-struct Note
+// resample audio data to a new output rate
+static void resample_audio(AudioData& data, unsigned outRate, ResampleQuality quality)
 {
-	float beatDuration;	// number of beats to sustain for
-	PSF filter;			// plucked string filter to sample from
-	float currentTime;	// current time tracker
-	float barOffset;	// beat offset in the measure
-
-	// ctors
-	Note(float freq, float duration, float _barOffset, float RVal = 0.99985f) 
-		: beatDuration(duration), filter(freq, duration, RVal), currentTime(0.f), barOffset(_barOffset) {}
-	Note& operator=(const Note&) = default;
-};
+	if (outRate == data.sampleRate)
+		return;
+
+	auto start = std::chrono::steady_clock::now();
+	data.data = resample(data.data, data.sampleRate, outRate, quality, BLOCK_SIZE);
+	auto end = std::chrono::steady_clock::now();
 
-// measure within a song definition
-struct Measure
+	double seconds = std::chrono::duration<double>(end - start).count();
+	stream << "resampled " << data.sampleRate << " Hz to " << outRate << " Hz (" << resample_quality_name(quality)
+		<< ") at " << data.num_samples() / static_cast<double>(outRate) / seconds << "x real time" << endl;
+	data.sampleRate = outRate;
+}
+
+// write audio data out to a lossless FLAC file
+// samples are converted and encoded one block at a time, then decoded again to verify the file
+// @return whether the file was written and verified
+static bool write_flac(const char* filename, const AudioData& data)
 {
-	std::vector<Note> sustainedNotes;	// notes sustained from the previous measure and during play
-	std::vector<Note> notesToAdd;		// notes that will play this measure
-};
+	FlacEncoder encoder;
+	if (!encoder.open(filename, data.sampleRate))
+		return false;
 
-// song definition: nothing more than a name and a list of measures
-struct Song
+	auto start = std::chrono::steady_clock::now();
+
+	// convert and stream the samples to the encoder a block at a time
+	short block[FLAC_BLOCK_SIZE];
+	for (unsigned i = 0; i < data.num_samples(); i += FLAC_BLOCK_SIZE)
+	{
+		unsigned count = std::min(FLAC_BLOCK_SIZE, data.num_samples() - i);
+		for (unsigned j = 0; j < count; ++j)
+			block[j] = FLOAT_TO_SHORT(data.data[i + j]);
+		encoder.write(block, count);
+	}
+	encoder.close();
+
+	auto end = std::chrono::steady_clock::now();
+	double encodeSeconds = std::chrono::duration<double>(end - start).count();
+
+	// decode the file and compare it to the source samples
+	std::vector<short> decoded;
+	unsigned decodedRate = 0;
+	bool verified = flac_decode(filename, decoded, decodedRate) && decodedRate == data.sampleRate &&
+		decoded.size() == data.num_samples();
+	for (unsigned i = 0; verified && i < data.num_samples(); ++i)
+		verified = (decoded[i] == FLOAT_TO_SHORT(data.data[i]));
+
+	// report compression ratio against the 16 bit .wav file and encode throughput
+	double wavBytes = 44.0 + data.size_in_bytes();
+	stream << filename << ": " << encoder.totalBytes << " bytes, compression ratio " << wavBytes / encoder.totalBytes
+		<< ", encoded at " << data.num_samples() / encodeSeconds / 1.0e6 << " Msamples/s ("
+		<< data.num_samples() / data.rate() / encodeSeconds << "x real time), "
+		<< (verified ? "verified" : "VERIFICATION FAILED") << endl;
+
+	return verified;
+}
+
+// helper function to render part of a block of a note into a mix
+// @param voiceEdges: +1 is added where the note starts in the block, -1 where it stops
+// @return the number of samples rendered
+static unsigned play_note(Note& note, float* mix, int* voiceEdges, unsigned offset, unsigned count)
 {
-	std::string name;				// wav filename
-	std::vector<Measure> measures;	// list of measures that make the song
-};
+	unsigned remaining = note.length_samples() - std::min(note.currentSample, note.length_samples());
+	unsigned n = std::min(count - offset, remaining);
 
-// helper function to play a measure to output AudioData
-static void play_measure(AudioData& data, Measure& measure)
+	note.filter.process(mix + offset, n);
+	note.currentSample += n;
+
+	voiceEdges[offset] += 1;
+	voiceEdges[offset + n] -= 1;
+	return n;
+}
+
+// helper function for the number of samples in a measure
+static unsigned measure_length_samples()
 {
 	const float length_seconds = 4.f * QUARTER_NOTE;	// length of the measure in seconds
-	const float sample_length = 1.f / RATE;				// length of 1 sample in seconds
-	const float length_samples = RATE * length_seconds;	// number of samples in the measure
+	return static_cast<unsigned>(std::ceil(RATE * length_seconds));
+}
 
-	// for each sample in the measure
-	for (float i = 0.f; i < length_seconds; i += sample_length)
+// helper function to remove notes that finished playing
+static void retire_notes(std::vector<Note>& notes)
+{
+	auto finished = std::remove_if(notes.begin(), notes.end(), [](const Note& note)
 	{
-		// average together each note playing simultaneously to get the final sample output for this sample
-		float average = 0.f;
-		unsigned numSamples = 0; // number of notes playing during this sample
+		return note.currentSample >= note.length_samples();
+	});
+	notes.erase(finished, notes.end());
+}
+
+// helper function to average together each note playing simultaneously to get the final output of a block
+// (silence if no notes are playing)
+static void output_block(AudioData& data, const float* mix, const int* voiceEdges, unsigned count)
+{
+	int numVoices = 0;
+	for (unsigned i = 0; i < count; ++i)
+	{
+		numVoices += voiceEdges[i];
+		data.data.push_back(numVoices ? mix[i] / static_cast<float>(numVoices) : 0.f);
+	}
+}
+
+// helper function to play a measure to output AudioData
+// @param budget: optional CPU budget, notes are rendered at lower quality to keep each block within it
+// @param denormals: optional denormal safety settings and counters
+static void play_measure(AudioData& data, Measure& measure, RenderBudget* budget, DenormalMode* denormals)
+{
+	const unsigned length_samples = measure_length_samples();	// number of samples in the measure
+
+	float mix[BLOCK_SIZE];				// sum of the notes playing during each sample of the block
+	int voiceEdges[BLOCK_SIZE + 1];		// change in the number of notes playing at each sample of the block
+
+	// for each block in the measure
+	for (unsigned blockStart = 0; blockStart < length_samples; blockStart += BLOCK_SIZE)
+	{
+		const unsigned count = std::min(BLOCK_SIZE, length_samples - blockStart);
+		std::fill(mix, mix + count, 0.f);
+		std::fill(voiceEdges, voiceEdges + count + 1, 0);
+
+		// pick the quality of each note to fit the budget
+		auto blockBegin = std::chrono::steady_clock::now();
+		if (budget)
+			budget->plan(measure.sustainedNotes, count);
 
 		// sample sustained notes
 		for (Note& note : measure.sustainedNotes)
 		{
-			average += note.filter();
-			++numSamples;
-			note.currentTime += sample_length;
+			unsigned n = play_note(note, mix, voiceEdges, 0, count);
+			if (budget)
+				budget->account(note, n);
+			if (denormals)
+				denormals->finish(note, n);
 		}
 
 		// add new notes if applicable
+		// notes that aren't added yet are compacted in order, erasing one at a time is O(n^2) on big songs
+		size_t numWaiting = 0;
 		for (size_t j = 0; j < measure.notesToAdd.size(); ++j)
 		{
 			Note& note = measure.notesToAdd[j];
+			unsigned start = note.start_sample();
 
-			// case add the new note
-			if (note.barOffset * QUARTER_NOTE <= i)
+			// case add the new note, starting partway through the block
+			if (start < blockStart + count)
 			{
 				// add to list of sustained notes
 				measure.sustainedNotes.push_back(note);
 
-				// delete from list of notes to add
-				measure.notesToAdd.erase(measure.notesToAdd.begin() + j);
-				--j;
-
 				// sample next note
-				average += measure.sustainedNotes.back().filter();
-				++numSamples;
-				measure.sustainedNotes.back().currentTime += sample_length;
+				Note& added = measure.sustainedNotes.back();
+				if (denormals)
+					denormals->start(added);
+				unsigned n = play_note(added, mix, voiceEdges, start > blockStart ? start - blockStart : 0, count);
+				if (budget)
+					budget->account(added, n);
+				if (denormals)
+					denormals->finish(added, n);
 			}
-		}
-		
-		// removed notes that are finished
-		for (size_t j = 0; j < measure.sustainedNotes.size(); ++j)
-		{
-			Note& note = measure.sustainedNotes[j];
-			if (note.currentTime >= note.beatDuration * QUARTER_NOTE)
+			// case note keeps waiting
+			else
 			{
-				measure.sustainedNotes.erase(measure.sustainedNotes.begin() + j);
-				--j;
+				if (numWaiting != j)
+					measure.notesToAdd[numWaiting] = note;
+				++numWaiting;
 			}
 		}
+		measure.notesToAdd.erase(measure.notesToAdd.begin() + numWaiting, measure.notesToAdd.end());
+		
+		// removed notes that are finished
+		retire_notes(measure.sustainedNotes);
+
+		// average together each note playing simultaneously to get the final output
+		output_block(data, mix, voiceEdges, count);
 
-		// add next sample to the output data
-		data.data.push_back(average / static_cast<float>(numSamples));
+		if (budget)
+			budget->record(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - blockBegin).count());
 	}
 }
 
-// function to play a song to an AudioData output
-static void play_song(AudioData& data, Song& song)
+// helper function to play a range of measures to an AudioData output
+// @param sus: notes sustained into the first measure, replaced with the notes still playing after the last one
+static void play_measures(AudioData& data, std::vector<Measure>& measures, size_t first, size_t last, std::vector<Note>& sus,
+	RenderBudget* budget, DenormalMode* denormals)
 {
-	// length of the song in seconds
-	float length_seconds = static_cast<float>(song.measures.size()) * 4.f * QUARTER_NOTE;
-	float length_samples = RATE * length_seconds;	// length of the song in samples
-	std::vector<Note> sus;							// notes carried over from previous measures
+	data.data.reserve(data.data.size() + (last - first) * measure_length_samples());
 
-	// process each measure in the song
-	for (Measure& measure : song.measures)
+	// process each measure in the range
+	for (size_t m = first; m < last; ++m)
 	{
+		Measure& measure = measures[m];
+
 		// add sustained notes from the previous measure to the current measure
 		measure.sustainedNotes.clear();
-		for (Note note : sus)
-			measure.sustainedNotes.push_back(note);
+		measure.sustainedNotes.swap(sus);
 
 		// play the current measure
-		play_measure(data, measure);
+		play_measure(data, measure, budget, denormals);
 
 		// add notes sustained from the measure to the next measure
-		sus.clear();
-		for(Note note : measure.sustainedNotes)
-			sus.push_back(note);
+		sus.swap(measure.sustainedNotes);
+	}
+}
+
+// function to play a song to an AudioData output
+// @param budget: optional CPU budget per block
+// @param denormals: optional denormal safety settings and counters
+static void play_song(AudioData& data, Song& song, RenderBudget* budget = nullptr, DenormalMode* denormals = nullptr)
+{
+	DenormalGuard guard(denormals && denormals->ftz);
+
+	std::vector<Note> sus;	// notes carried over from previous measures
+	play_measures(data, song.measures, 0, song.measures.size(), sus, budget, denormals);
+}
+
+// function to play a MIDI timeline to an AudioData output
+// notes are only made (and their delay lines allocated) when they start, so memory follows the polyphony, not the length
+// @param budget: optional CPU budget per block
+// @param denormals: optional denormal safety settings and counters
+static void play_timeline(AudioData& data, const MidiTimeline& timeline, RenderBudget* budget = nullptr, DenormalMode* denormals = nullptr)
+{
+	DenormalGuard guard(denormals && denormals->ftz);
+
+	const std::vector<MidiNote>& notes = timeline.notes;
+	const double samplesPerBeat = static_cast<double>(QUARTER_NOTE) * RATE;
+
+	float mix[BLOCK_SIZE];				// sum of the notes playing during each sample of the block
+	int voiceEdges[BLOCK_SIZE + 1];		// change in the number of notes playing at each sample of the block
+	std::vector<Note> playing;			// notes playing in the current block
+	size_t next = 0;					// next note to start
+
+	data.data.reserve(data.data.size() + timeline.lengthSamples);
+
+	// for each block in the timeline
+	for (unsigned blockStart = 0; blockStart < timeline.lengthSamples; blockStart += BLOCK_SIZE)
+	{
+		const unsigned count = std::min(BLOCK_SIZE, timeline.lengthSamples - blockStart);
+		std::fill(mix, mix + count, 0.f);
+		std::fill(voiceEdges, voiceEdges + count + 1, 0);
+
+		// pick the quality of each note to fit the budget
+		auto blockBegin = std::chrono::steady_clock::now();
+		if (budget)
+			budget->plan(playing, count);
+
+		// sample playing notes
+		for (Note& note : playing)
+		{
+			unsigned n = play_note(note, mix, voiceEdges, 0, count);
+			if (budget)
+				budget->account(note, n);
+			if (denormals)
+				denormals->finish(note, n);
+		}
+
+		// start notes, partway through the block
+		for (; next < notes.size() && notes[next].startSample < blockStart + count; ++next)
+		{
+			const MidiNote& m = notes[next];
+			float beats = static_cast<float>(m.lengthSamples / samplesPerBeat);
+			if (m.sustain)
+				playing.emplace_back(midi_to_frequency(m.key), beats, 0.f, SUS_NOTE);
+			else
+				playing.emplace_back(midi_to_frequency(m.key), beats, 0.f);
+
+			Note& added = playing.back();
+			if (denormals)
+				denormals->start(added);
+			unsigned n = play_note(added, mix, voiceEdges, m.startSample - blockStart, count);
+			if (budget)
+				budget->account(added, n);
+			if (denormals)
+				denormals->finish(added, n);
+		}
+
+		// removed notes that are finished
+		retire_notes(playing);
+
+		// average together each note playing simultaneously to get the final output
+		output_block(data, mix, voiceEdges, count);
+
+		if (budget)
+			budget->record(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - blockBegin).count());
+	}
+}
+
+// helper function to split a song into segments of measures with about the same number of note samples
+// @return the first measure of each segment, followed by the number of measures
+static std::vector<size_t> split_segments(const Song& song, unsigned numSegments)
+{
+	std::vector<double> work(song.measures.size() + 1, 0.0);
+	for (size_t m = 0; m < song.measures.size(); ++m)
+	{
+		work[m + 1] = work[m] + 1.0;	// the mixing cost of an empty measure
+		for (const Note& note : song.measures[m].notesToAdd)
+			work[m + 1] += note.length_samples() / static_cast<double>(BLOCK_SIZE);
+	}
+
+	std::vector<size_t> bounds(1, 0);
+	for (unsigned k = 1; k < numSegments; ++k)
+	{
+		double target = work.back() * k / numSegments;
+		size_t m = std::lower_bound(work.begin(), work.end(), target) - work.begin();
+		if (m > bounds.back() && m < song.measures.size())
+			bounds.push_back(m);
+	}
+	bounds.push_back(song.measures.size());
+	return bounds;
+}
+
+// computes the notes still playing at the start of each segment, with their filter states
+// voices don't affect each other, so only the notes that cross a boundary are rendered (and their output thrown away),
+// on the same block grid as the full render so the states come out bit for bit the same
+// @return for each segment, the notes sustained into its first measure
+static std::vector<std::vector<Note>> checkpoint_segments(const Song& song, const std::vector<size_t>& bounds, const DenormalMode* denormals)
+{
+	const unsigned long long length = measure_length_samples();
+	std::vector<std::vector<Note>> checkpoints(bounds.size() - 1);
+
+	// same floating point mode as the render, but nothing is counted twice
+	DenormalMode mode = denormals ? *denormals : DenormalMode();
+	mode.count = false;
+	DenormalGuard guard(mode.ftz);
+
+	std::vector<Note> sus;
+	for (size_t k = 0; k + 2 < bounds.size(); ++k)
+	{
+		const size_t first = bounds[k], last = bounds[k + 1];
+		const unsigned long long boundary = last * length;
+
+		// notes sustained into the segment that are still playing at its end
+		std::vector<Note> carried;
+		for (const Note& note : sus)
+		{
+			if (first * length + note.length_samples() - note.currentSample > boundary)
+				carried.push_back(note);
+		}
+
+		// notes started in the segment that are still playing at its end
+		std::vector<Measure> crossing(last - first);
+		for (size_t m = first; m < last; ++m)
+		{
+			for (const Note& note : song.measures[m].notesToAdd)
+			{
+				unsigned start = note.start_sample();
+				if (start < length && m * length + start + note.length_samples() > boundary)
+					crossing[m - first].notesToAdd.push_back(note);
+			}
+		}
+
+		// render from the first measure with a crossing note, a measure at a time since the output is thrown away
+		size_t m = 0;
+		if (carried.empty())
+		{
+			while (m < crossing.size() && crossing[m].notesToAdd.empty())
+				++m;
+		}
+		AudioData discarded;
+		for (; m < crossing.size(); ++m)
+		{
+			play_measures(discarded, crossing, m, m + 1, carried, nullptr, &mode);
+			discarded.data.clear();
+		}
+		checkpoints[k + 1] = carried;
+		sus.swap(carried);
+	}
+
+	return checkpoints;
+}
+
+// function to play a song to an AudioData output on several threads, one contiguous segment of measures each
+// the song should be seeded with seed_excitation so its noise doesn't depend on the render order
+// @param denormals: optional denormal safety settings and counters
+// @param checkpointSeconds: optional output for the time spent computing the checkpoints
+static void play_song_parallel(AudioData& data, Song& song, unsigned numThreads, DenormalMode* denormals = nullptr,
+	double* checkpointSeconds = nullptr)
+{
+	std::vector<size_t> bounds = split_segments(song, std::max(1u, numThreads));
+	const size_t numSegments = bounds.size() - 1;
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::vector<Note>> checkpoints = checkpoint_segments(song, bounds, denormals);
+	if (checkpointSeconds)
+		*checkpointSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// render the segments, each thread with its own output and counters (the first one renders straight to data)
+	std::vector<AudioData> segments(numSegments);
+	segments[0].data.swap(data.data);
+	DenormalMode settings = denormals ? *denormals : DenormalMode();
+	settings.subnormals = settings.noteBlocks = settings.subnormalNoteBlocks = settings.flushed = 0;
+	std::vector<DenormalMode> modes(numSegments, settings);
+	std::vector<std::thread> threads;
+	for (size_t k = 0; k < numSegments; ++k)
+	{
+		threads.emplace_back([&, k]()
+		{
+			DenormalGuard guard(modes[k].ftz);
+			play_measures(segments[k], song.measures, bounds[k], bounds[k + 1], checkpoints[k], nullptr,
+				denormals ? &modes[k] : nullptr);
+		});
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+
+	// stitch the segments together
+	data.data.swap(segments[0].data);
+	size_t total = data.data.size();
+	for (size_t k = 1; k < numSegments; ++k)
+		total += segments[k].data.size();
+	data.data.reserve(total);
+	for (size_t k = 1; k < numSegments; ++k)
+		data.data.insert(data.data.end(), segments[k].data.begin(), segments[k].data.end());
+
+	if (denormals)
+	{
+		for (const DenormalMode& mode : modes)
+		{
+			denormals->subnormals += mode.subnormals;
+			denormals->noteBlocks += mode.noteBlocks;
+			denormals->subnormalNoteBlocks += mode.subnormalNoteBlocks;
+			denormals->flushed += mode.flushed;
+		}
+	}
+}
+
+// scalability benchmark: renders generated songs at 10, 100, 1000 and 10000 simultaneous voices
+// reports throughput, memory per voice, and the first voice count where scaling breaks down
+static void run_benchmarks()
+{
+	const unsigned voiceCounts[] = { 10, 100, 1000, 10000 };
+	const double voiceSamplesTarget = 5.0e7;	// rough amount of work per scenario
+	double baselineNs = 0.0;
+	bool reportedBreakdown = false;
+
+	// single voice: one sample at a time against the block kernel
+	{
+		const unsigned numSamples = 60 * RATE;
+		std::vector<float> out(numSamples, 0.f);
+		PSF scalarVoice(220.f, 1.f, SUS_NOTE), blockVoice(220.f, 1.f, SUS_NOTE);
+
+		auto start = std::chrono::steady_clock::now();
+		for (unsigned i = 0; i < numSamples; ++i)
+			out[i] += scalarVoice();
+		auto mid = std::chrono::steady_clock::now();
+		for (unsigned i = 0; i < numSamples; i += BLOCK_SIZE)
+			blockVoice.process(out.data() + i, std::min(BLOCK_SIZE, numSamples - i));
+		auto end = std::chrono::steady_clock::now();
+
+		double scalarNs = std::chrono::duration<double, std::nano>(mid - start).count() / numSamples;
+		double blockNs = std::chrono::duration<double, std::nano>(end - mid).count() / numSamples;
+		stream << "single voice: " << scalarNs << " ns/sample per sample, " << blockNs << " ns/sample in blocks ("
+			<< scalarNs / blockNs << "x" << (PSF_SIMD ? ", SSE" : ", no SIMD") << ")" << endl;
+	}
+
+	stream << "voices  peak  seconds  render(s)  realtime  Mvoice-samples/s  ns/voice-sample  bytes/voice" << endl;
+
+	for (unsigned voices : voiceCounts)
+	{
+		// keep the amount of work per scenario similar: fewer measures for more voices
+		GeneratorParams params;
+		params.voices = voices;
+		double measureSeconds = 4.0 * QUARTER_NOTE;
+		params.measures = static_cast<unsigned>(std::max(1.0, voiceSamplesTarget / (voices * measureSeconds * RATE)));
+
+		std::vector<GeneratedNote> notes = generate_notes(params);
+		Song song = generate_song(params, "benchmark.wav");
+
+		// memory held by a playing voice: the note and its comb filter delay line
+		double delayBytes = 0.0;
+		for (const GeneratedNote& g : notes)
+		{
+			float freq = note_to_frequency(midi_note_name(g.midiNote), midi_note_octave(g.midiNote));
+			delayBytes += std::floor(static_cast<float>(RATE) / freq - 0.5f) * sizeof(float);
+		}
+		double bytesPerVoice = sizeof(Note) + (notes.empty() ? 0.0 : delayBytes / notes.size());
+
+		AudioData data;
+		auto start = std::chrono::steady_clock::now();
+		play_song(data, song);
+		auto end = std::chrono::steady_clock::now();
+
+		double renderSeconds = std::chrono::duration<double>(end - start).count();
+		double audioSeconds = data.num_samples() / data.rate();
+		double voiceSamples = static_cast<double>(voices) * data.num_samples();
+		double nsPerVoiceSample = 1.0e9 * renderSeconds / voiceSamples;
+		if (baselineNs == 0.0)
+			baselineNs = nsPerVoiceSample;
+
+		stream << voices << "\t" << peak_polyphony(notes) << "\t" << audioSeconds << "\t" << renderSeconds << "\t"
+			<< audioSeconds / renderSeconds << "x\t" << voiceSamples / renderSeconds / 1.0e6 << "\t"
+			<< nsPerVoiceSample << "\t" << bytesPerVoice << endl;
+
+		// scaling breaks down when the cost of one voice grows, or when the render can't keep up with real time
+		if (!reportedBreakdown && (nsPerVoiceSample > 2.0 * baselineNs || renderSeconds > audioSeconds))
+		{
+			stream << "  scaling breaks down at " << voices << " voices: "
+				<< (renderSeconds > audioSeconds ? "slower than real time" : "cost per voice more than doubled") << endl;
+			reportedBreakdown = true;
+		}
+	}
+}
+
+// CPU budget benchmark: renders a 1,000 voice song at full quality, then again under budgets
+// that are fractions of the full quality cost, comparing each render against the full quality one
+static void run_budget_benchmark()
+{
+	const double fractions[] = { 1.0, 0.75, 0.5, 0.35, 0.25 };
+
+	GeneratorParams params;
+	params.voices = 1000;
+	params.measures = 4;
+
+	// full quality reference
+	AudioData reference;
+	Song song = generate_song(params, "benchmark.wav");
+	std::srand(1);
+	auto start = std::chrono::steady_clock::now();
+	play_song(reference, song);
+	auto end = std::chrono::steady_clock::now();
+
+	const double blocks = std::ceil(static_cast<double>(reference.num_samples()) / BLOCK_SIZE);
+	const double fullBlockNs = std::chrono::duration<double, std::nano>(end - start).count() / blocks;
+	stream << params.voices << " voices, full quality: " << fullBlockNs / 1000.0 << " us/block ("
+		<< 1.0e9 * BLOCK_SIZE / RATE / fullBlockNs << "x real time)" << endl;
+
+	stream << "budget  us/block  over budget  average(us)  slowest(us)  full  no allpass  half rate  changes  energy shed  SNR(dB)" << endl;
+	for (double fraction : fractions)
+	{
+		RenderBudget budget(fraction * fullBlockNs);
+		budget.calibrate(BLOCK_SIZE);
+
+		// same song and excitation noise as the reference
+		AudioData data;
+		song = generate_song(params, "benchmark.wav");
+		std::srand(1);
+		play_song(data, song, &budget);
+
+		// cheaper levels shift the phase of the notes, so this is a pessimistic measure of the damage
+		double signal = 0.0, noise = 0.0;
+		for (unsigned i = 0; i < data.num_samples(); ++i)
+		{
+			signal += reference.data[i] * reference.data[i];
+			noise += (data.data[i] - reference.data[i]) * (data.data[i] - reference.data[i]);
+		}
+
+		double total = budget.voiceSamples[psfFull] + budget.voiceSamples[psfNoAllpass] + budget.voiceSamples[psfHalfRate];
+		stream << 100.0 * fraction << "%\t" << budget.blockNs / 1000.0 << "\t" << 100.0 * budget.blocksOver / budget.blocks << "%\t"
+			<< budget.totalNs / budget.blocks / 1000.0 << "\t" << budget.maxNs / 1000.0 << "\t"
+			<< 100.0 * budget.voiceSamples[psfFull] / total << "%\t" << 100.0 * budget.voiceSamples[psfNoAllpass] / total << "%\t"
+			<< 100.0 * budget.voiceSamples[psfHalfRate] / total << "%\t" << budget.levelChanges << "\t"
+			<< 100.0 * budget.energy_shed() << "%\t" << (noise > 0.0 ? 10.0 * std::log10(signal / noise) : INFINITY) << endl;
 	}
+
+	RenderBudget calibrated(fullBlockNs);
+	calibrated.calibrate(BLOCK_SIZE);
+	stream << "calibrated cost per note sample: full " << calibrated.levelNs[psfFull] << " ns, no allpass "
+		<< calibrated.levelNs[psfNoAllpass] << " ns, half rate " << calibrated.levelNs[psfHalfRate] << " ns" << endl;
 }
 
-// main: plays 
-int main(void)
+// denormal benchmark: renders a song of long, unsustained notes whose tails decay into the subnormal range
+// (about 57 dB per second, so after roughly 13 seconds) with each of the denormal defenses
+static void run_denormal_benchmark()
 {
+	// 64 strings, each ringing for 64 beats (18 seconds), starting a measure apart in groups of 8
+	Song song;
+	song.name = "tails.wav";
+	song.measures.resize(24);
+	for (unsigned v = 0; v < 64; ++v)
+	{
+		float freq = 110.f * std::pow(2.f, static_cast<float>(v % 24) / 12.f);
+		song.measures[v / 8].notesToAdd.emplace_back(freq, 64.f, static_cast<float>(v % 8) * 0.5f);
+	}
+
+	struct Scenario { const char* name; DenormalMode mode; };
+	DenormalMode counted;
+	counted.count = true;
+	DenormalMode ftz;
+	ftz.ftz = true;
+	DenormalMode flush;
+	flush.flushLevel = DenormalMode::safe().flushLevel;
+	DenormalMode noise;
+	noise.noiseFloor = DenormalMode::safe(true).noiseFloor;
+	const Scenario scenarios[] = {
+		{ "plain", DenormalMode() },
+		{ "plain, counted", counted },
+		{ "FTZ/DAZ", ftz },
+		{ "flush", flush },
+		{ "noise floor", noise },
+		{ "safe (FTZ/DAZ + flush)", DenormalMode::safe() },
+		{ "safe + noise floor", DenormalMode::safe(true) },
+	};
+
+	double plainSeconds = 0.0;
+	stream << "mode                     render(s)  realtime  speedup  flushed  subnormal values  note blocks with subnormals" << endl;
+	for (const Scenario& scenario : scenarios)
+	{
+		// count subnormals in every scenario but the plain one, the scan is cheap next to a subnormal render
+		DenormalMode mode = scenario.mode;
+		if (&scenario != &scenarios[0])
+			mode.count = true;
+
+		Song copy = song;
+		AudioData data;
+		std::srand(1);
+		auto start = std::chrono::steady_clock::now();
+		play_song(data, copy, nullptr, &mode);
+		auto end = std::chrono::steady_clock::now();
+
+		double seconds = std::chrono::duration<double>(end - start).count();
+		if (plainSeconds == 0.0)
+			plainSeconds = seconds;
+
+		stream << scenario.name << "\t" << seconds << "\t" << data.num_samples() / data.rate() / seconds << "x\t"
+			<< plainSeconds / seconds << "x\t" << mode.flushed << "\t";
+		if (mode.count)
+			stream << mode.subnormals << "\t" << mode.subnormalNoteBlocks << " / " << mode.noteBlocks << endl;
+		else
+			stream << "-\t-" << endl;
+	}
+}
+
+// parallel benchmark: renders a monophonic and a 10 voice song on 1 to 8 threads
+// the parallel renders are checked against a single threaded render of the same seeded song
+static void run_parallel_benchmark()
+{
+	const unsigned voiceCounts[] = { 1, 10 };
+	const unsigned threadCounts[] = { 1, 2, 4, 8 };
+
+	stream << "hardware threads: " << std::thread::hardware_concurrency() << endl;
+	stream << "voices  threads  render(s)  checkpoints(s)  realtime  speedup  identical" << endl;
+	for (unsigned voices : voiceCounts)
+	{
+		GeneratorParams params;
+		params.voices = voices;
+		params.measures = 500 / voices;
+
+		// single threaded reference
+		Song song = generate_song(params, "benchmark.wav");
+		seed_excitation(song);
+		AudioData reference;
+		auto start = std::chrono::steady_clock::now();
+		play_song(reference, song);
+		double serialSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		stream << voices << "\tserial\t" << serialSeconds << "\t-\t" << reference.num_samples() / reference.rate() / serialSeconds << "x" << endl;
+
+		for (unsigned threads : threadCounts)
+		{
+			song = generate_song(params, "benchmark.wav");
+			seed_excitation(song);
+			AudioData data;
+			double checkpointSeconds = 0.0;
+			start = std::chrono::steady_clock::now();
+			play_song_parallel(data, song, threads, nullptr, &checkpointSeconds);
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			stream << voices << "\t" << threads << "\t" << seconds << "\t" << checkpointSeconds << "\t"
+				<< data.num_samples() / data.rate() / seconds << "x\t" << serialSeconds / seconds << "x\t"
+				<< (data.data == reference.data ? "yes" : "NO") << endl;
+		}
+	}
+}
+
+// MIDI benchmark: parses a generated 32 track MIDI file with a tempo map, and compares parsing to rendering it
+static void run_midi_benchmark()
+{
+	const unsigned numParses = 20;
+
+	GeneratorParams params;
+	params.voices = 32;
+	params.measures = 128;
+	std::vector<unsigned char> bytes = generate_midi(params);
+
+	// the tempo map cycles through 100%, 80%, 100% and 125% every 4 measures
+	const double percents[4] = { 1.0, 0.8, 1.0, 1.25 };
+	double expectedSeconds = 0.0;
+	for (unsigned m = 0; m < params.measures; ++m)
+		expectedSeconds += 4.0 * QUARTER_NOTE / percents[(m / 4) % 4];
+
+	MidiTimeline timeline;
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned i = 0; i < numParses; ++i)
+		parse_midi(bytes.data(), bytes.size(), timeline);
+	auto end = std::chrono::steady_clock::now();
+	double parseSeconds = std::chrono::duration<double>(end - start).count() / numParses;
+
+	stream << "MIDI file: " << bytes.size() << " bytes, format " << timeline.format << ", " << timeline.tracks << " tracks, "
+		<< timeline.events << " events, " << timeline.tempoChanges << " tempo changes, " << timeline.notes.size() << " notes" << endl;
+	stream << "length: " << timeline.lengthSamples / static_cast<double>(RATE) << " s (the tempo map ends the last measure at " << expectedSeconds << " s)" << endl;
+	stream << "parse: " << parseSeconds * 1000.0 << " ms (" << bytes.size() / parseSeconds / 1.0e6 << " MB/s, "
+		<< timeline.events / parseSeconds / 1.0e6 << " Mevents/s)" << endl;
+
+	AudioData data;
+	start = std::chrono::steady_clock::now();
+	play_timeline(data, timeline);
+	end = std::chrono::steady_clock::now();
+	double renderSeconds = std::chrono::duration<double>(end - start).count();
+
+	stream << "render: " << renderSeconds << " s (" << data.num_samples() / data.rate() / renderSeconds << "x real time), parsing is "
+		<< 100.0 * parseSeconds / renderSeconds << "% of the render" << endl;
+
+	// truncated files: every prefix of a small file is parsed from a buffer of exactly its size,
+	// so reading past the end shows up under a memory checker
+	params.voices = 4;
+	params.measures = 4;
+	std::vector<unsigned char> small = generate_midi(params);
+	unsigned numParsed = 0;
+	for (size_t size = 0; size <= small.size(); ++size)
+	{
+		std::vector<unsigned char> prefix(small.begin(), small.begin() + size);
+		if (parse_midi(prefix.data(), prefix.size(), timeline))
+			++numParsed;
+	}
+
+	// a track that ends in a delta time, with no event after it
+	const unsigned char deltaAtEnd[] = { 'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0, 96,
+		'M', 'T', 'r', 'k', 0, 0, 0, 5, 0x00, 0x90, 0x3C, 0x64, 0x10 };
+	std::vector<unsigned char> truncated(std::begin(deltaAtEnd), std::end(deltaAtEnd));
+	parse_midi(truncated.data(), truncated.size(), timeline);
+	stream << "truncated files: " << numParsed << " of " << small.size() + 1 << " prefixes parsed, a track ending in a delta time reads 1 event: "
+		<< (timeline.events == 1 && timeline.notes.size() == 1 ? "yes" : "NO") << endl;
+}
+
+// convolution benchmark: partitioned FFT convolution against direct convolution for growing impulse responses
+static void run_convolution_benchmark()
+{
+	const float irSeconds[] = { 0.1f, 0.5f, 1.f, 2.f, 4.f };
+	const unsigned inputLength = 10 * RATE;		// samples run through the partitioned convolver
+	const unsigned directLength = 4096;			// samples run through direct convolution (it's slow)
+
+	std::srand(1);
+	std::vector<float> input(inputLength + 4 * RATE);
+	for (float& x : input)
+		x = SHORT_TO_FLOAT(RAND_BETWEEN(-15000, 15000));
+
+	stream << "IR(s)  taps  block  partitions  partitioned(ns/sample)  direct(ns/sample)  speedup  max error" << endl;
+	for (float seconds : irSeconds)
+	{
+		// exponentially decaying noise, like a room
+		std::vector<float> ir(static_cast<size_t>(seconds * RATE));
+		for (size_t i = 0; i < ir.size(); ++i)
+			ir[i] = SHORT_TO_FLOAT(RAND_BETWEEN(-15000, 15000)) * std::exp(-6.9f * i / ir.size()) * 0.01f;
+
+		// partitioned convolution over the whole input
+		Convolver convolver(ir, convolution_block_size(ir.size()));
+		std::vector<float> partitioned(input.size());
+		auto start = std::chrono::steady_clock::now();
+		for (unsigned i = 0; i < input.size(); i += BLOCK_SIZE)
+			convolver.process(&input[i], &partitioned[i], std::min(BLOCK_SIZE, static_cast<unsigned>(input.size()) - i));
+		auto mid = std::chrono::steady_clock::now();
+
+		// direct convolution once the whole impulse response overlaps the input
+		std::vector<float> direct(directLength);
+		size_t first = ir.size();
+		direct_convolve(input, ir, direct.data(), first, directLength);
+		auto end = std::chrono::steady_clock::now();
+
+		// partitioned output is delayed by the block size
+		float maxError = 0.f;
+		for (unsigned i = 0; i < directLength; ++i)
+			maxError = std::max(maxError, std::abs(partitioned[first + i + convolver.B] - direct[i]));
+
+		double partitionedNs = std::chrono::duration<double, std::nano>(mid - start).count() / input.size();
+		double directNs = std::chrono::duration<double, std::nano>(end - mid).count() / directLength;
+		stream << seconds << "\t" << ir.size() << "\t" << convolver.B << "\t" << convolver.numParts << "\t" << partitionedNs << "\t"
+			<< directNs << "\t" << directNs / partitionedNs << "x\t" << maxError << endl;
+	}
+}
+
+// resampler benchmark: throughput and accuracy for each output rate and quality preset
+static void run_resampler_benchmark()
+{
+	const unsigned outRates[] = { 22050, 32000, 48000, 88200, 96000, 192000 };
+	const unsigned inputLength = 60 * RATE;
+	const float freq = 1000.f;
+
+	// a sine is resampled so the output can be compared to the exact result
+	std::vector<float> input(inputLength);
+	for (unsigned i = 0; i < inputLength; ++i)
+		input[i] = 0.5f * std::sin(2.0 * 3.14159265358979323846 * freq * i / RATE);
+
+	stream << "rate    quality  phases  taps  real time  ns/output sample  SNR(dB)" << endl;
+	for (unsigned outRate : outRates)
+	{
+		for (int q = 0; q < rqCount; ++q)
+		{
+			ResampleQuality quality = static_cast<ResampleQuality>(q);
+			Resampler resampler(RATE, outRate, quality);
+
+			auto start = std::chrono::steady_clock::now();
+			std::vector<float> output = resample(input, RATE, outRate, quality, BLOCK_SIZE);
+			auto end = std::chrono::steady_clock::now();
+			double seconds = std::chrono::duration<double>(end - start).count();
+
+			// compare to the sine at the output rate, skipping the edges and the fractional delay resample leaves
+			double delay = resampler.latency() - std::floor(resampler.latency() + 0.5);
+			double signal = 0.0, noise = 0.0;
+			for (size_t j = output.size() / 10; j < output.size() * 9 / 10; ++j)
+			{
+				double t = (j - delay) * resampler.downFactor / resampler.upFactor;
+				double exact = 0.5 * std::sin(2.0 * 3.14159265358979323846 * freq * t / RATE);
+				signal += exact * exact;
+				noise += (output[j] - exact) * (output[j] - exact);
+			}
+
+			stream << outRate << "\t" << resample_quality_name(quality) << "\t" << resampler.upFactor << "\t" << resampler.taps << "\t"
+				<< static_cast<double>(inputLength) / RATE / seconds << "x\t" << seconds * 1.0e9 / output.size() << "\t"
+				<< 10.0 * std::log10(signal / std::max(noise, 1e-30)) << endl;
+		}
+	}
+}
+
+// main: plays the song in Song.songdef
+// optional arguments:
+//   --flac                           write a lossless .flac file instead of a .wav file
+//   --ir <file.wav> [--wet <amount>] convolve the song with an impulse response (body or room)
+//   --rate <hz> [--quality <preset>] resample the output to another rate (presets: fast, medium, high)
+//   --budget <us>                    render each block within a CPU budget, dropping quiet notes to cheaper quality
+//   --denormal-safe [--noise-floor]  render with FTZ/DAZ and flush inaudible strings, optionally feeding in a noise floor
+//   --count-subnormals               count and report subnormal values produced by the render
+//   --threads <n>                    render contiguous segments of the song on n threads (notes get seeded noise)
+//   --bench                          run the scalability benchmark instead
+//   --bench-budget                   run the CPU budget benchmark instead
+//   --bench-denormals                run the denormal benchmark instead
+//   --bench-parallel                 run the parallel rendering benchmark instead
+//   --bench-midi                     run the MIDI parsing benchmark instead
+//   --bench-convolution              run the convolution benchmark instead
+//   --bench-resampler                run the resampler benchmark instead
+//   --midi <file.mid>                play a format 0 or 1 MIDI file instead
+//   --generate-midi <file.mid>       write a generated song as a MIDI file instead, shaped like --generate
+//   --generate <file.songdef>        write a generated song instead, shaped by:
+//       --voices <n> --density <notes per measure> --sustain <ratio> --measures <n> --seed <n>
+int main(int argc, char** argv)
+{
+	GeneratorParams params;
+	const char* generateFile = nullptr;
+	const char* generateMidiFile = nullptr;
+	const char* midiFile = nullptr;
+	bool flacOutput = false;
+	const char* irFile = nullptr;
+	float wet = 0.35f;
+	unsigned outRate = RATE;
+	double budgetUs = 0.0;
+	bool denormalSafe = false;
+	bool noiseFloor = false;
+	bool countSubnormals = false;
+	unsigned numThreads = 0;
+	ResampleQuality quality = rqHigh;
+
+	// parse command line arguments
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+
+		if (std::strcmp(arg, "--bench") == 0)
+		{
+			run_benchmarks();
+			return 0;
+		}
+		else if (std::strcmp(arg, "--bench-convolution") == 0)
+		{
+			run_convolution_benchmark();
+			return 0;
+		}
+		else if (std::strcmp(arg, "--bench-budget") == 0)
+		{
+			run_budget_benchmark();
+			return 0;
+		}
+		else if (std::strcmp(arg, "--bench-denormals") == 0)
+		{
+			run_denormal_benchmark();
+			return 0;
+		}
+		else if (std::strcmp(arg, "--bench-parallel") == 0)
+		{
+			run_parallel_benchmark();
+			return 0;
+		}
+		else if (std::strcmp(arg, "--bench-midi") == 0)
+		{
+			run_midi_benchmark();
+			return 0;
+		}
+		else if (value && std::strcmp(arg, "--midi") == 0)
+			midiFile = argv[++i];
+		else if (value && std::strcmp(arg, "--generate-midi") == 0)
+			generateMidiFile = argv[++i];
+		else if (value && std::strcmp(arg, "--threads") == 0)
+			numThreads = static_cast<unsigned>(std::atoi(argv[++i]));
+		else if (std::strcmp(arg, "--denormal-safe") == 0)
+			denormalSafe = true;
+		else if (std::strcmp(arg, "--noise-floor") == 0)
+			noiseFloor = true;
+		else if (std::strcmp(arg, "--count-subnormals") == 0)
+			countSubnormals = true;
+		else if (std::strcmp(arg, "--bench-resampler") == 0)
+		{
+			run_resampler_benchmark();
+			return 0;
+		}
+		else if (std::strcmp(arg, "--flac") == 0)
+			flacOutput = true;
+		else if (value && std::strcmp(arg, "--ir") == 0)
+			irFile = argv[++i];
+		else if (value && std::strcmp(arg, "--wet") == 0)
+			wet = static_cast<float>(std::atof(argv[++i]));
+		else if (value && std::strcmp(arg, "--budget") == 0)
+			budgetUs = std::atof(argv[++i]);
+		else if (value && std::strcmp(arg, "--rate") == 0)
+			outRate = static_cast<unsigned>(std::atoi(argv[++i]));
+		else if (value && std::strcmp(arg, "--quality") == 0)
+		{
+			const char* name = argv[++i];
+			int q = 0;
+			while (q < rqCount && std::strcmp(name, resample_quality_name(static_cast<ResampleQuality>(q))) != 0)
+				++q;
+			if (q == rqCount)
+			{
+				stream << "unknown quality: " << name << endl;
+				return 1;
+			}
+			quality = static_cast<ResampleQuality>(q);
+		}
+		else if (value && std::strcmp(arg, "--generate") == 0)
+			generateFile = argv[++i];
+		else if (value && std::strcmp(arg, "--voices") == 0)
+			params.voices = static_cast<unsigned>(std::atoi(argv[++i]));
+		else if (value && std::strcmp(arg, "--density") == 0)
+			params.notesPerMeasure = static_cast<unsigned>(std::atoi(argv[++i]));
+		else if (value && std::strcmp(arg, "--sustain") == 0)
+			params.sustainRatio = static_cast<float>(std::atof(argv[++i]));
+		else if (value && std::strcmp(arg, "--measures") == 0)
+			params.measures = static_cast<unsigned>(std::atoi(argv[++i]));
+		else if (value && std::strcmp(arg, "--seed") == 0)
+			params.seed = static_cast<unsigned>(std::atoi(argv[++i]));
+		else
+		{
+			stream << "unknown argument: " << arg << endl;
+			return 1;
+		}
+	}
+
+	if (outRate < 8000 || outRate > 384000)
+	{
+		stream << "unsupported output rate: " << outRate << endl;
+		return 1;
+	}
+
+	// case write out a generated song
+	if (generateFile)
+	{
+		if (!write_songdef(generateFile, params, "generated.wav"))
+		{
+			stream << "couldn't write " << generateFile << endl;
+			return 1;
+		}
+		return 0;
+	}
+
+	// case write out a generated song as a MIDI file
+	if (generateMidiFile)
+	{
+		if (!write_midi(generateMidiFile, params))
+		{
+			stream << "couldn't write " << generateMidiFile << endl;
+			return 1;
+		}
+		return 0;
+	}
+
 	// took the first 40 measures of the song Mister Sandman from this musescore score.
 	//https://musescore.com/user/1187206/scores/968751
 
@@ -345,13 +1260,92 @@ int main(void)
 	// process the song (costly operation)
 	AudioData data;
 
+	// denormal safety
+	DenormalMode denormals = denormalSafe ? DenormalMode::safe(noiseFloor) : DenormalMode();
+	denormals.count = countSubnormals;
+	const bool useDenormals = denormalSafe || countSubnormals;
+
+	// read the MIDI file, it's played instead of the song
+	MidiTimeline timeline;
+	std::string outputName = song.name;
+	if (midiFile)
+	{
+		if (!read_midi(midiFile, timeline))
+		{
+			stream << "couldn't read " << midiFile << ": " << timeline.error << endl;
+			return 1;
+		}
+		std::string name = midiFile;
+		outputName = name.substr(0, name.rfind('.')) + ".wav";
+		stream << midiFile << ": format " << timeline.format << ", " << timeline.tracks << " tracks, " << timeline.notes.size()
+			<< " notes, " << timeline.lengthSamples / static_cast<float>(RATE) << " seconds" << endl;
+	}
+
 	// play song to data file
-	play_song(data, song);
+	if (numThreads > 0 && budgetUs > 0.0 && !midiFile)
+		stream << "--budget renders on one thread, --threads is ignored" << endl;
+	if (midiFile)
+	{
+		if (numThreads > 0)
+			stream << "MIDI files render on one thread, --threads is ignored" << endl;
+		RenderBudget budget(1000.0 * budgetUs);
+		if (budgetUs > 0.0)
+			budget.calibrate(BLOCK_SIZE);
+		play_timeline(data, timeline, budgetUs > 0.0 ? &budget : nullptr, useDenormals ? &denormals : nullptr);
+		if (budgetUs > 0.0)
+			budget.report(stream);
+	}
+	else if (numThreads > 0 && budgetUs <= 0.0)
+	{
+		seed_excitation(song);
+		play_song_parallel(data, song, numThreads, useDenormals ? &denormals : nullptr);
+	}
+	else if (budgetUs > 0.0)
+	{
+		RenderBudget budget(1000.0 * budgetUs);
+		budget.calibrate(BLOCK_SIZE);
+		play_song(data, song, &budget, useDenormals ? &denormals : nullptr);
+		budget.report(stream);
+	}
+	else
+	{
+		play_song(data, song, nullptr, useDenormals ? &denormals : nullptr);
+	}
+
+	if (useDenormals)
+		denormals.report(stream);
+
+	// add the instrument body or room
+	if (irFile)
+	{
+		std::vector<float> ir;
+		unsigned irRate = 0;
+		if (!read_wave(irFile, ir, irRate))
+		{
+			stream << "couldn't read impulse response " << irFile << endl;
+			return 1;
+		}
+		if (irRate != RATE)
+			ir = resample(ir, irRate, RATE, rqHigh);
+		apply_reverb(data, ir, wet);
+	}
+
+	// resample before normalizing so the filter ringing can't clip
+	resample_audio(data, outRate, quality);
 
 	normalize(data);
 
 	// write the data to a file
-	write_wave(song.name.c_str(), data);
+	if (flacOutput)
+	{
+		std::string name = outputName.substr(0, outputName.rfind('.')) + ".flac";
+		if (!write_flac(name.c_str(), data))
+			return 1;
+	}
+	else
+	{
+		write_wave(outputName.c_str(), data);
+	}
 
 	return 0;
 }
@@ -0,0 +1,289 @@
+/*
+	------------------------------------------------------------------------------
+		Licensing information can be found at the end of the file.
+	------------------------------------------------------------------------------
+
+	File:   render_budget.h - v1.0
+	Author: Matthew Rosen
+
+	Summary:
+		CPU budgeted rendering: before each block the quietest playing notes are
+		dropped to cheaper PSF quality levels until the predicted cost of the block
+		fits the budget, and quality is given back to the loudest ones when there's
+		headroom again. Keeps statistics on how much quality was shed.
+
+	Revision history:
+		1.0		(10/18/2026)	initial release
+*/
+#ifndef __MAT320_RENDER_BUDGET_H
+#define __MAT320_RENDER_BUDGET_H
+
+// includes
+#include "filters.h"
+#include "song.h"
+#include <algorithm>
+#include <chrono>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+// per block CPU budget for rendering notes
+struct RenderBudget
+{
+	double blockNs;								// budget for one block, in nanoseconds
+	float maxCents;								// largest tuning error a cheaper quality level may add
+	float restoreRatio;							// quality is given back while the prediction stays under this fraction of the budget
+	unsigned restoreDelay;						// number of blocks in a row with headroom before quality is given back
+	unsigned calmBlocks;						// number of blocks in a row with headroom so far
+	double levelNs[psfQualityCount];			// cost of one sample of one note at each quality level
+	double overheadNs;							// cost of one note sample outside the filters (mixing, bookkeeping, cache misses), smoothed
+	double blockFilterNs;						// predicted filter cost of the notes rendered in the current block
+	double blockSamples;						// note samples rendered in the current block
+
+	// statistics
+	unsigned long long blocks;					// number of blocks rendered
+	unsigned long long blocksOver;				// number of blocks that went over budget
+	unsigned long long levelChanges;			// number of quality level changes
+	double voiceSamples[psfQualityCount];		// note samples rendered at each quality level
+	double voiceEnergy[psfQualityCount];		// note energy rendered at each quality level
+	double totalNs;								// time spent rendering blocks
+	double maxNs;								// slowest block
+
+	std::vector<std::pair<float, size_t>> order;	// scratch space: notes sorted by loudness
+
+	explicit RenderBudget(double _blockNs, float _maxCents = 15.f) : blockNs(_blockNs), maxCents(_maxCents), restoreRatio(0.8f), restoreDelay(8), calmBlocks(0),
+		overheadNs(0.0), blockFilterNs(0.0), blockSamples(0.0), blocks(0), blocksOver(0), levelChanges(0), totalNs(0.0), maxNs(0.0)
+	{
+		std::fill(levelNs, levelNs + psfQualityCount, 1.0);
+		std::fill(voiceSamples, voiceSamples + psfQualityCount, 0.0);
+		std::fill(voiceEnergy, voiceEnergy + psfQualityCount, 0.0);
+	}
+
+	// measures the cost of each quality level on a few hundred notes, so delay lines compete for cache like in a song
+	// the notes have no excitation, so rand() isn't called and renders stay reproducible
+	void calibrate(unsigned blockSize)
+	{
+		const unsigned numVoices = 256;
+		const unsigned numBlocks = 16;
+		std::vector<float> out(blockSize);
+		for (int q = 0; q < psfQualityCount; ++q)
+		{
+			std::vector<PSF> voices;
+			voices.reserve(numVoices);
+			for (unsigned v = 0; v < numVoices; ++v)
+			{
+				voices.emplace_back(82.f * std::pow(2.f, 4.f * v / numVoices), 0.f);
+				voices.back().set_quality(static_cast<PSFQuality>(q));
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			for (unsigned b = 0; b < numBlocks; ++b)
+			{
+				for (PSF& voice : voices)
+					voice.process(out.data(), blockSize);
+			}
+			auto end = std::chrono::steady_clock::now();
+
+			levelNs[q] = std::chrono::duration<double, std::nano>(end - start).count() / (numVoices * numBlocks * blockSize);
+		}
+	}
+
+	// next quality level that is cheaper and within the tuning tolerance, or the current one if there's none
+	PSFQuality cheaper(const PSF& filter) const
+	{
+		for (int q = filter.quality() + 1; q < psfQualityCount; ++q)
+		{
+			if (levelNs[q] < levelNs[filter.quality()] && filter.tuning_error(static_cast<PSFQuality>(q)) <= maxCents)
+				return static_cast<PSFQuality>(q);
+		}
+		return filter.quality();
+	}
+
+	// next better quality level within the tuning tolerance (full quality is always allowed)
+	PSFQuality better(const PSF& filter) const
+	{
+		for (int q = filter.quality() - 1; q > psfFull; --q)
+		{
+			if (filter.tuning_error(static_cast<PSFQuality>(q)) <= maxCents)
+				return static_cast<PSFQuality>(q);
+		}
+		return psfFull;
+	}
+
+	// number of samples a note still plays in a block
+	static unsigned samples_in_block(const Note& note, unsigned count)
+	{
+		return std::min(count, note.length_samples() - std::min(note.currentSample, note.length_samples()));
+	}
+
+	// predicted cost of rendering a block of notes
+	double predict(const std::vector<Note>& notes, unsigned count) const
+	{
+		double ns = 0.0;
+		for (const Note& note : notes)
+			ns += (levelNs[note.filter.quality()] + overheadNs) * samples_in_block(note, count);
+		return ns;
+	}
+
+	// picks the quality level of each note for the next block
+	void plan(std::vector<Note>& notes, unsigned count)
+	{
+		double predicted = predict(notes, count);
+		const double restoreNs = restoreRatio * blockNs;
+		calmBlocks = (predicted < restoreNs) ? calmBlocks + 1 : 0;
+		if (predicted <= blockNs && (predicted >= restoreNs || calmBlocks < restoreDelay))
+			return;
+
+		// sort the notes by loudness
+		order.clear();
+		for (size_t i = 0; i < notes.size(); ++i)
+		{
+			if (notes[i].filter.excited())
+				order.emplace_back(notes[i].filter.loudness(), i);
+		}
+		std::sort(order.begin(), order.end());
+
+		if (predicted > blockNs)
+		{
+			// over budget: drop the quietest notes a level at a time until the block fits
+			for (int pass = psfFull; pass + 1 < psfQualityCount && predicted > blockNs; ++pass)
+			{
+				for (size_t j = 0; j < order.size() && predicted > blockNs; ++j)
+				{
+					Note& note = notes[order[j].second];
+					PSFQuality from = note.filter.quality(), to = cheaper(note.filter);
+					if (to == from)
+						continue;
+					predicted -= (levelNs[from] - levelNs[to]) * samples_in_block(note, count);
+					note.filter.set_quality(to);
+					++levelChanges;
+				}
+			}
+		}
+		else
+		{
+			// headroom: give quality back to the loudest notes while it stays well under budget
+			for (size_t j = order.size(); j-- > 0;)
+			{
+				Note& note = notes[order[j].second];
+				PSFQuality from = note.filter.quality();
+				if (from == psfFull)
+					continue;
+				PSFQuality to = better(note.filter);
+				double added = (levelNs[to] - levelNs[from]) * samples_in_block(note, count);
+				if (predicted + added > restoreNs)
+					break;
+				predicted += added;
+				note.filter.set_quality(to);
+				++levelChanges;
+			}
+		}
+	}
+
+	// counts samples a note rendered in the current block
+	void account(const Note& note, unsigned samples)
+	{
+		float loudness = note.filter.loudness();
+		blockFilterNs += levelNs[note.filter.quality()] * samples;
+		blockSamples += samples;
+		voiceSamples[note.filter.quality()] += samples;
+		voiceEnergy[note.filter.quality()] += static_cast<double>(loudness) * loudness * samples;
+	}
+
+	// fraction of the note samples rendered below full quality
+	double samples_shed() const
+	{
+		double total = voiceSamples[psfFull] + voiceSamples[psfNoAllpass] + voiceSamples[psfHalfRate];
+		return total > 0.0 ? 1.0 - voiceSamples[psfFull] / total : 0.0;
+	}
+
+	// fraction of the note energy rendered below full quality, small when only quiet notes were dropped
+	double energy_shed() const
+	{
+		double total = voiceEnergy[psfFull] + voiceEnergy[psfNoAllpass] + voiceEnergy[psfHalfRate];
+		return total > 0.0 ? 1.0 - voiceEnergy[psfFull] / total : 0.0;
+	}
+
+	// records the time a block took and corrects the cost model with it
+	// whatever the filters don't account for is spread over the note samples, so it doesn't shrink when quality is shed
+	void record(double ns)
+	{
+		++blocks;
+		totalNs += ns;
+		maxNs = std::max(maxNs, ns);
+		if (ns > blockNs)
+			++blocksOver;
+
+		if (blockSamples > 0.0)
+			overheadNs = 0.9 * overheadNs + 0.1 * std::max(0.0, (ns - blockFilterNs) / blockSamples);
+		blockFilterNs = 0.0;
+		blockSamples = 0.0;
+	}
+
+	// prints how the budget was met and how much quality was shed
+	void report(std::ostream& out) const
+	{
+		static const char* names[psfQualityCount] = { "full", "no allpass", "half rate" };
+
+		double total = 0.0;
+		for (int q = 0; q < psfQualityCount; ++q)
+			total += voiceSamples[q];
+		total = std::max(total, 1.0);
+
+		out << "budget " << blockNs / 1000.0 << " us/block: " << blocks << " blocks, " << blocksOver << " over budget ("
+			<< 100.0 * blocksOver / std::max(1ull, blocks) << "%), average " << totalNs / std::max(1ull, blocks) / 1000.0
+			<< " us, slowest " << maxNs / 1000.0 << " us" << std::endl;
+		out << "  note samples at";
+		for (int q = 0; q < psfQualityCount; ++q)
+			out << (q ? ", " : " ") << names[q] << " " << 100.0 * voiceSamples[q] / total << "%";
+		out << " (" << levelChanges << " level changes, " << maxCents << " cents tuning tolerance)" << std::endl;
+		out << "  quality shed: " << 100.0 * samples_shed() << "% of note samples, " << 100.0 * energy_shed()
+			<< "% of note energy" << std::endl;
+		out << "  cost per note sample:";
+		for (int q = 0; q < psfQualityCount; ++q)
+			out << (q ? ", " : " ") << names[q] << " " << levelNs[q] << " ns";
+		out << " calibrated, plus " << overheadNs << " ns measured overhead" << std::endl;
+	}
+};
+
+#endif //__MAT320_RENDER_BUDGET_H
+
+/*
+	------------------------------------------------------------------------------
+	This software is available under 2 licenses - you may choose the one you like.
+	------------------------------------------------------------------------------
+	ALTERNATIVE A - zlib license
+	Copyright (c) 2019 Matthew Rosen
+	This software is provided 'as-is', without any express or implied warranty.
+	In no event will the authors be held liable for any damages arising from
+	the use of this software.
+	Permission is granted to anyone to use this software for any purpose,
+	including commercial applications, and to alter it and redistribute it
+	freely, subject to the following restrictions:
+	  1. The origin of this software must not be misrepresented; you must not
+		 claim that you wrote the original software. If you use this software
+		 in a product, an acknowledgment in the product documentation would be
+		 appreciated but is not required.
+	  2. Altered source versions must be plainly marked as such, and must not
+		 be misrepresented as being the original software.
+	  3. This notice may not be removed or altered from any source distribution.
+	------------------------------------------------------------------------------
+	ALTERNATIVE B - Public Domain (www.unlicense.org)
+	This is free and unencumbered software released into the public domain.
+	Anyone is free to copy, modify, publish, use, compile, sell, or distribute this
+	software, either in source code form or as a compiled binary, for any purpose,
+	commercial or non-commercial, and by any means.
+	In jurisdictions that recognize copyright laws, the author or authors of this
+	software dedicate any and all copyright interest in the software to the public
+	domain. We make this dedication for the benefit of the public at large and to
+	the detriment of our heirs and successors. We intend this dedication to be an
+	overt act of relinquishment in perpetuity of all present and future rights to
+	this software under copyright law.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+	ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+	WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+	------------------------------------------------------------------------------
+*/
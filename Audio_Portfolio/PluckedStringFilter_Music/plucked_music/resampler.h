@@ -0,0 +1,279 @@
+/*
+	------------------------------------------------------------------------------
+		Licensing information can be found at the end of the file.
+	------------------------------------------------------------------------------
+
+	File:   resampler.h - v1.0
+	Author: Matthew Rosen
+
+	Summary:
+		Streaming polyphase resampler used to convert rendered audio from the
+		synthesis rate to other output rates (48 kHz, 96 kHz, ...).
+		Filters are Kaiser windowed sincs split into one table per phase, so each
+		output sample is a single SIMD inner product over the input history.
+
+	Revision history:
+		1.0		(10/18/2026)	initial release
+*/
+#ifndef __MAT320_RESAMPLER_H
+#define __MAT320_RESAMPLER_H
+
+// includes
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// SSE is used for the inner products when available (always on x64)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	define RESAMPLER_SIMD 1
+#	include <emmintrin.h>
+#else
+#	define RESAMPLER_SIMD 0
+#endif
+
+// quality presets, higher quality uses more taps per phase
+enum ResampleQuality
+{
+	rqFast,		// 16 taps, ~60 dB stopband, passband to 85% of nyquist
+	rqMedium,	// 32 taps, ~80 dB stopband, passband to 90% of nyquist
+	rqHigh,		// 64 taps, ~100 dB stopband, passband to 94% of nyquist
+	rqCount
+};
+
+// name of a quality preset, for reports and command line parsing
+static const char* resample_quality_name(ResampleQuality quality)
+{
+	static const char* names[rqCount] = { "fast", "medium", "high" };
+	return names[quality];
+}
+
+// helper function for the Kaiser window: zeroth order modified bessel function of the first kind
+static double bessel_i0(double x)
+{
+	double sum = 1.0, term = 1.0;
+	for (int k = 1; k < 50 && term > 1e-12 * sum; ++k)
+	{
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+// helper function to compute the inner product of two arrays, count must be a multiple of 4
+static inline float dot_product(const float* a, const float* b, unsigned count)
+{
+#if RESAMPLER_SIMD
+	__m128 sum0 = _mm_setzero_ps();
+	__m128 sum1 = _mm_setzero_ps();
+	unsigned i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+	}
+	if (i < count)
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+
+	// horizontal sum of the four lanes
+	sum0 = _mm_add_ps(sum0, sum1);
+	sum0 = _mm_add_ps(sum0, _mm_movehl_ps(sum0, sum0));
+	sum0 = _mm_add_ss(sum0, _mm_shuffle_ps(sum0, sum0, 1));
+	return _mm_cvtss_f32(sum0);
+#else
+	float sum = 0.f;
+	for (unsigned i = 0; i < count; ++i)
+		sum += a[i] * b[i];
+	return sum;
+#endif
+}
+
+// streaming polyphase resampler
+// the rate ratio is reduced to upFactor / downFactor. output sample j sits at time j * downFactor
+// on a grid upFactor times finer than the input, so its filter is the phase (j * downFactor) % upFactor
+// of the prototype lowpass. ratios needing more than MAX_PHASES phases are approximated,
+// the pitch error of that is below 0.02 cents.
+struct Resampler
+{
+	static const unsigned MAX_PHASES = 4096;
+
+	unsigned inRate;			// input sampling rate
+	unsigned outRate;			// output sampling rate
+	unsigned upFactor;			// number of phases (L)
+	unsigned downFactor;		// phase increment per output sample (M)
+	unsigned taps;				// taps per phase (multiple of 4)
+	std::vector<float> coefs;	// upFactor phases of taps coefficients, reversed to match the input order
+	std::vector<float> history;	// input samples still needed, starting with taps - 1 samples of history
+	size_t next;				// index in history of the newest input sample of the next output
+	unsigned phase;				// phase of the next output
+
+	Resampler(unsigned _inRate, unsigned _outRate, ResampleQuality quality = rqMedium)
+		: inRate(_inRate), outRate(_outRate), upFactor(1), downFactor(1), taps(0), next(0), phase(0)
+	{
+		// reduce the ratio
+		unsigned a = inRate, b = outRate;
+		while (b) { unsigned t = a % b; a = b; b = t; }
+		upFactor = outRate / a;
+		downFactor = inRate / a;
+		if (upFactor > MAX_PHASES)
+		{
+			downFactor = static_cast<unsigned>(std::floor(static_cast<double>(MAX_PHASES) * inRate / outRate + 0.5));
+			upFactor = MAX_PHASES;
+		}
+
+		// quality presets: taps per phase, Kaiser beta and passband edge
+		static const unsigned presetTaps[rqCount] = { 16, 32, 64 };
+		static const double presetBeta[rqCount] = { 6.0, 8.0, 10.0 };
+		static const double presetRolloff[rqCount] = { 0.85, 0.9, 0.94 };
+		taps = presetTaps[quality];
+
+		// prototype lowpass at upFactor times the input rate, cut off below the lower nyquist
+		const unsigned length = taps * upFactor;
+		const double cutoff = presetRolloff[quality] * 0.5 / std::max(upFactor, downFactor);	// cycles per sample
+		const double center = 0.5 * (length - 1);
+		const double windowNorm = 1.0 / bessel_i0(presetBeta[quality]);
+		const double pi = 3.14159265358979323846;
+
+		coefs.resize(length);
+		for (unsigned p = 0; p < upFactor; ++p)
+		{
+			for (unsigned k = 0; k < taps; ++k)
+			{
+				// tap k of phase p multiplies the input k samples before the newest one
+				double t = (p + static_cast<double>(k) * upFactor) - center;
+				double x = 2.0 * cutoff * t;
+				double sinc = (std::abs(x) < 1e-12) ? 1.0 : std::sin(pi * x) / (pi * x);
+				double r = t / (center + 0.5);
+				double window = bessel_i0(presetBeta[quality] * std::sqrt(std::max(0.0, 1.0 - r * r))) * windowNorm;
+
+				// gain of upFactor makes up for the zeros stuffed between input samples
+				coefs[p * taps + (taps - 1 - k)] = static_cast<float>(upFactor * 2.0 * cutoff * sinc * window);
+			}
+		}
+
+		reset();
+	}
+
+	// clears the input history
+	void reset()
+	{
+		history.assign(taps - 1, 0.f);
+		next = taps - 1;
+		phase = 0;
+	}
+
+	// delay of the filter in output samples
+	double latency() const
+	{
+		return 0.5 * (taps * upFactor - 1) / downFactor;
+	}
+
+	// number of output samples produced for a number of input samples (rounded down)
+	size_t output_length(size_t inputLength) const
+	{
+		return static_cast<size_t>(static_cast<unsigned long long>(inputLength) * upFactor / downFactor);
+	}
+
+	// resamples a block of input, appending the output samples to out
+	void process(const float* in, unsigned count, std::vector<float>& out)
+	{
+		history.insert(history.end(), in, in + count);
+
+		const unsigned stepWhole = downFactor / upFactor;
+		const unsigned stepPart = downFactor % upFactor;
+		// every output whose newest input sample has arrived can be made now
+		size_t available = next < history.size() ?
+			((history.size() - next) * upFactor - phase + downFactor - 1) / downFactor : 0;
+		size_t first = out.size();
+		out.resize(first + available);
+		float* dest = out.data() + first;
+
+		for (size_t j = 0; j < available; ++j)
+		{
+			dest[j] = dot_product(coefs.data() + static_cast<size_t>(phase) * taps, history.data() + (next - (taps - 1)), taps);
+
+			next += stepWhole;
+			phase += stepPart;
+			if (phase >= upFactor)
+			{
+				phase -= upFactor;
+				++next;
+			}
+		}
+
+		// keep only the history the next output needs
+		size_t consumed = std::min(next - (taps - 1), history.size());
+		history.erase(history.begin(), history.begin() + consumed);
+		next -= consumed;
+	}
+
+	// pushes zeros through the filter so the last input samples reach the output
+	void flush(std::vector<float>& out)
+	{
+		std::vector<float> zeros(taps, 0.f);
+		process(zeros.data(), taps, out);
+	}
+};
+
+// resamples a whole signal, compensating for the filter delay
+// the output holds inputLength * outRate / inRate samples lined up with the input
+static std::vector<float> resample(const std::vector<float>& in, unsigned inRate, unsigned outRate,
+	ResampleQuality quality = rqMedium, unsigned blockSize = 256)
+{
+	if (inRate == outRate)
+		return in;
+
+	Resampler resampler(inRate, outRate, quality);
+	std::vector<float> out;
+	out.reserve(resampler.output_length(in.size()) + resampler.taps * 2 + 1);
+
+	for (size_t i = 0; i < in.size(); i += blockSize)
+		resampler.process(in.data() + i, static_cast<unsigned>(std::min<size_t>(blockSize, in.size() - i)), out);
+	resampler.flush(out);
+
+	// drop the whole samples of delay, the fraction left over is at most half an output sample
+	size_t skip = std::min(out.size(), static_cast<size_t>(resampler.latency() + 0.5));
+	size_t length = std::min(out.size() - skip, resampler.output_length(in.size()));
+	return std::vector<float>(out.begin() + skip, out.begin() + skip + length);
+}
+
+#endif //__MAT320_RESAMPLER_H
+
+/*
+	------------------------------------------------------------------------------
+	This software is available under 2 licenses - you may choose the one you like.
+	------------------------------------------------------------------------------
+	ALTERNATIVE A - zlib license
+	Copyright (c) 2019 Matthew Rosen
+	This software is provided 'as-is', without any express or implied warranty.
+	In no event will the authors be held liable for any damages arising from
+	the use of this software.
+	Permission is granted to anyone to use this software for any purpose,
+	including commercial applications, and to alter it and redistribute it
+	freely, subject to the following restrictions:
+	  1. The origin of this software must not be misrepresented; you must not
+		 claim that you wrote the original software. If you use this software
+		 in a product, an acknowledgment in the product documentation would be
+		 appreciated but is not required.
+	  2. Altered source versions must be plainly marked as such, and must not
+		 be misrepresented as being the original software.
+	  3. This notice may not be removed or altered from any source distribution.
+	------------------------------------------------------------------------------
+	ALTERNATIVE B - Public Domain (www.unlicense.org)
+	This is free and unencumbered software released into the public domain.
+	Anyone is free to copy, modify, publish, use, compile, sell, or distribute this
+	software, either in source code form or as a compiled binary, for any purpose,
+	commercial or non-commercial, and by any means.
+	In jurisdictions that recognize copyright laws, the author or authors of this
+	software dedicate any and all copyright interest in the software to the public
+	domain. We make this dedication for the benefit of the public at large and to
+	the detriment of our heirs and successors. We intend this dedication to be an
+	overt act of relinquishment in perpetuity of all present and future rights to
+	this software under copyright law.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+	ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+	WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+	------------------------------------------------------------------------------
+*/
@@ -0,0 +1,203 @@
+/*
+	------------------------------------------------------------------------------
+		Licensing information can be found at the end of the file.
+	------------------------------------------------------------------------------
+
+	File:   song.h - v1.0
+	Author: Matthew Rosen
+
+	Summary:
+		Song definition types shared by the renderer and the song generator:
+		Notes, Measures, Songs, and the macros used by .songdef files.
+
+	Revision history:
+		1.0		(10/18/2026)	split out of plucked_music.cpp
+		1.1		(10/18/2026)	notes keep time in samples for block rendering
+		1.2		(10/18/2026)	per note excitation noise seeds
+*/
+#ifndef __MAT320_SONG_H
+#define __MAT320_SONG_H
+
+// includes
+#include "filters.h"
+#include <string>
+#include <vector>
+
+// global constants (defined in plucked_music.cpp)
+extern const unsigned RATE;
+extern const float QUARTER_NOTE;
+extern const float SUS_NOTE;
+
+// helper function to convert a given note to a frequency
+// @param noteName: a string with either 1 or 2 characters. "<Note letter><modifier>", e.g. Eb for "E flat"
+// @param octave:   integer octave number for the note to be in. Values should range from -1 to 7.
+// @return the given note's frequency in Hz
+static float note_to_frequency(const std::string& noteName, int octave)
+{
+	const float baseFreq = 440.f;
+	float modifier = 0;
+	char noteChar = 0;
+
+	// extract a modifier if it exists (modifier is 1 if note is sharp or -1 if note is flat, 0 otherwise)
+	if (noteName.size() > 1)
+	{
+		char modChar = noteName[1];
+		if (modChar == 'b')
+			modifier = -1.f;
+		else if (modChar == 's' || modChar == '#')
+			modifier = 1.f;
+	}
+
+	// extract the note letter
+	if (noteName.size() >= 1)
+	{
+		noteChar = noteName.front();
+	}
+
+	// verify note letter and octave are valid
+	if (noteChar < 'A' || noteChar > 'G' || octave < -1 || octave > 7)
+		return -1.f; // error with the note
+
+	float noteVal = 0.f; // noteVal is the half-step increment from A
+
+	// determine the half-step increment from A
+	switch (noteChar)
+	{
+	case 'A':
+		noteVal = 0;
+		break;
+	case 'B':
+		noteVal = 2.f; // half steps away from A
+		break;
+	case 'C':
+		noteVal = 3.f; // half steps away from A
+		break;
+	case 'D':
+		noteVal = 5.f; // half steps away from A
+		break;
+	case 'E':
+		noteVal = 7.f; // half steps away from A
+		break;
+	case 'F':
+		noteVal = 8.f; // half steps away from A
+		break;
+	case 'G':
+		noteVal = 10.f; // half steps away from A
+		break;
+	// default case guaranteed to never be hit
+	}
+
+	// calculate the frequency without octave modification using the sharp/flat modifier from above
+	float freq = baseFreq * std::pow(2.f, (noteVal + modifier) / 12.f);
+
+	// modify octave value based on if note is below a C (A and B are in the octave below)
+	// modification is because base frequency is in octave 3
+	if (noteVal < 3.f) octave -= 4;
+	else octave -= 5;
+
+	// convert to frequency multiplier
+	float octaveMult = std::pow(2.f, octave);
+
+	return freq * octaveMult;
+}
+
+// ease of use with defining a song
+#define N(n, o) note_to_frequency(#n, o)
+#define NOTE(note, octave, ...) Note(N(note, octave), __VA_ARGS__)
+#define MEASURE(...) {{}, { __VA_ARGS__ }}
+
+// note within a song definition
+struct Note
+{
+	float beatDuration;		// number of beats to sustain for
+	PSF filter;				// plucked string filter to sample from
+	unsigned currentSample;	// number of samples played so far
+	float barOffset;		// beat offset in the measure
+
+	// ctors
+	Note(float freq, float duration, float _barOffset, float RVal = 0.99985f)
+		: beatDuration(duration), filter(freq, duration, RVal), currentSample(0), barOffset(_barOffset) {}
+	Note& operator=(const Note&) = default;
+
+	// sample in the measure the note starts on
+	unsigned start_sample() const { return static_cast<unsigned>(std::ceil(barOffset * QUARTER_NOTE * RATE)); }
+
+	// number of samples the note plays for
+	unsigned length_samples() const { return static_cast<unsigned>(std::ceil(beatDuration * QUARTER_NOTE * RATE)); }
+};
+
+// measure within a song definition
+struct Measure
+{
+	std::vector<Note> sustainedNotes;	// notes sustained from the previous measure and during play
+	std::vector<Note> notesToAdd;		// notes that will play this measure
+};
+
+// song definition: nothing more than a name and a list of measures
+struct Song
+{
+	std::string name;				// wav filename
+	std::vector<Measure> measures;	// list of measures that make the song
+};
+
+// gives every note of a song its own excitation noise generator, seeded from its position in the song
+// a seeded song renders the same no matter what order (or thread) its notes are rendered in
+static void seed_excitation(Song& song, unsigned seed = 1)
+{
+	for (size_t m = 0; m < song.measures.size(); ++m)
+	{
+		for (size_t n = 0; n < song.measures[m].notesToAdd.size(); ++n)
+		{
+			// mix the seed, measure and note index (murmur3 finalizer), xorshift needs a nonzero state
+			unsigned h = seed * 0x9E3779B9u ^ static_cast<unsigned>(m) * 0x85EBCA6Bu ^ static_cast<unsigned>(n) * 0xC2B2AE35u;
+			h ^= h >> 16;
+			h *= 0x85EBCA6Bu;
+			h ^= h >> 13;
+			h *= 0xC2B2AE35u;
+			h ^= h >> 16;
+			song.measures[m].notesToAdd[n].filter.set_noise_seed(h ? h : 1);
+		}
+	}
+}
+
+#endif //__MAT320_SONG_H
+
+/*
+	------------------------------------------------------------------------------
+	This software is available under 2 licenses - you may choose the one you like.
+	------------------------------------------------------------------------------
+	ALTERNATIVE A - zlib license
+	Copyright (c) 2019 Matthew Rosen
+	This software is provided 'as-is', without any express or implied warranty.
+	In no event will the authors be held liable for any damages arising from
+	the use of this software.
+	Permission is granted to anyone to use this software for any purpose,
+	including commercial applications, and to alter it and redistribute it
+	freely, subject to the following restrictions:
+	  1. The origin of this software must not be misrepresented; you must not
+		 claim that you wrote the original software. If you use this software
+		 in a product, an acknowledgment in the product documentation would be
+		 appreciated but is not required.
+	  2. Altered source versions must be plainly marked as such, and must not
+		 be misrepresented as being the original software.
+	  3. This notice may not be removed or altered from any source distribution.
+	------------------------------------------------------------------------------
+	ALTERNATIVE B - Public Domain (www.unlicense.org)
+	This is free and unencumbered software released into the public domain.
+	Anyone is free to copy, modify, publish, use, compile, sell, or distribute this
+	software, either in source code form or as a compiled binary, for any purpose,
+	commercial or non-commercial, and by any means.
+	In jurisdictions that recognize copyright laws, the author or authors of this
+	software dedicate any and all copyright interest in the software to the public
+	domain. We make this dedication for the benefit of the public at large and to
+	the detriment of our heirs and successors. We intend this dedication to be an
+	overt act of relinquishment in perpetuity of all present and future rights to
+	this software under copyright law.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+	ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+	WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+	------------------------------------------------------------------------------
+*/
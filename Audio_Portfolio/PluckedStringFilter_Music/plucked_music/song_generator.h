@@ -0,0 +1,331 @@
+/*
+	------------------------------------------------------------------------------
+		Licensing information can be found at the end of the file.
+	------------------------------------------------------------------------------
+
+	File:   song_generator.h - v1.1
+	Author: Matthew Rosen
+
+	Summary:
+		Synthetic song generator used for scalability benchmarks.
+		Generates songs with a controllable number of simultaneous voices,
+		note density, sustain ratio and length, either straight into a Song,
+		written out as a .songdef file, or written out as a MIDI file.
+
+	Revision history:
+		1.0		(10/18/2026)	initial release
+		1.1		(10/18/2026)	MIDI file output
+*/
+#ifndef __MAT320_SONG_GENERATOR_H
+#define __MAT320_SONG_GENERATOR_H
+
+// includes
+#include "song.h"
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <utility>
+
+// parameters of a generated song
+struct GeneratorParams
+{
+	unsigned voices;			// number of simultaneous voices (polyphony)
+	unsigned notesPerMeasure;	// note density: notes started by each voice per measure (1, 2, 4 or 8)
+	float sustainRatio;			// fraction of notes played with SUS_NOTE (0 to 1)
+	unsigned measures;			// length of the song in measures
+	unsigned seed;				// random seed, the same seed generates the same song
+
+	GeneratorParams() : voices(10), notesPerMeasure(4), sustainRatio(0.25f), measures(8), seed(1) {}
+};
+
+// note generated before it's converted, so a Song and its .songdef text always agree
+struct GeneratedNote
+{
+	unsigned measure;	// measure index the note starts in
+	int midiNote;		// pitch as a MIDI note number
+	float duration;		// note duration in beats
+	float offset;		// beat offset in the measure
+	bool sustain;		// whether the note uses SUS_NOTE
+	unsigned voice;		// voice that plays the note
+};
+
+// helper function to convert a MIDI note number to the note name used by NOTE()
+static const char* midi_note_name(int midiNote)
+{
+	static const char* names[12] = { "C", "Cs", "D", "Eb", "E", "F", "Fs", "G", "Ab", "A", "Bb", "B" };
+	return names[midiNote % 12];
+}
+
+// helper function to convert a MIDI note number to the octave used by NOTE()
+static int midi_note_octave(int midiNote)
+{
+	return midiNote / 12 - 1;
+}
+
+// generates the notes of a song
+// each voice plays back to back notes, so the song holds params.voices notes at once.
+// voices are staggered by half beats so they don't all start on the same sample.
+static std::vector<GeneratedNote> generate_notes(const GeneratorParams& params)
+{
+	// notes are picked from a major scale over four octaves starting at E2
+	static const int scale[7] = { 0, 2, 4, 5, 7, 9, 11 };
+	const int lowNote = 40;
+	const int numOctaves = 4;
+
+	std::vector<GeneratedNote> notes;
+	std::mt19937 rng(params.seed);
+
+	unsigned notesPerMeasure = std::max(1u, std::min(8u, params.notesPerMeasure));
+	const float spacing = 4.f / static_cast<float>(notesPerMeasure);	// beats between notes of one voice
+	const float songBeats = 4.f * static_cast<float>(params.measures);
+	const unsigned phaseSlots = static_cast<unsigned>(spacing * 2.f);	// half beat slots within the spacing
+
+	notes.reserve(static_cast<size_t>(params.voices) * params.measures * notesPerMeasure);
+
+	std::uniform_real_distribution<float> chance(0.f, 1.f);
+	std::uniform_int_distribution<int> step(-2, 2);
+
+	for (unsigned v = 0; v < params.voices; ++v)
+	{
+		// start each voice on its own degree of the scale and spread them over the range
+		int degree = static_cast<int>(rng() % 7);
+		int octave = static_cast<int>(v % numOctaves);
+		float beat = 0.5f * static_cast<float>(rng() % phaseSlots);
+
+		for (; beat < songBeats; beat += spacing)
+		{
+			// random walk along the scale
+			degree += step(rng);
+			while (degree < 0) { degree += 7; --octave; }
+			while (degree >= 7) { degree -= 7; ++octave; }
+			octave = std::max(0, std::min(numOctaves - 1, octave));
+
+			int midiNote = lowNote + 12 * octave + scale[degree];
+
+			GeneratedNote note;
+			note.measure = static_cast<unsigned>(beat / 4.f);
+			note.offset = beat - 4.f * static_cast<float>(note.measure);
+			note.duration = spacing;
+			note.midiNote = midiNote;
+			note.sustain = chance(rng) < params.sustainRatio;
+			note.voice = v;
+			notes.push_back(note);
+		}
+	}
+
+	// sort by start time to match the order a person would write them in
+	std::stable_sort(notes.begin(), notes.end(), [](const GeneratedNote& a, const GeneratedNote& b)
+	{
+		return a.measure != b.measure ? a.measure < b.measure : a.offset < b.offset;
+	});
+
+	return notes;
+}
+
+// calculates the largest number of notes playing at once in a generated song
+static unsigned peak_polyphony(const std::vector<GeneratedNote>& notes)
+{
+	// sweep over note starts (+1) and ends (-1), ends sort first on ties
+	std::vector<std::pair<float, int>> events;
+	events.reserve(notes.size() * 2);
+	for (const GeneratedNote& note : notes)
+	{
+		float start = 4.f * static_cast<float>(note.measure) + note.offset;
+		events.emplace_back(start, 1);
+		events.emplace_back(start + note.duration, -1);
+	}
+	std::sort(events.begin(), events.end());
+
+	int current = 0, peak = 0;
+	for (const auto& e : events)
+	{
+		current += e.second;
+		peak = std::max(peak, current);
+	}
+	return static_cast<unsigned>(peak);
+}
+
+// converts generated notes to a playable song
+static Song generate_song(const GeneratorParams& params, const std::string& name)
+{
+	Song song;
+	song.name = name;
+	song.measures.resize(params.measures);
+
+	for (const GeneratedNote& g : generate_notes(params))
+	{
+		float freq = note_to_frequency(midi_note_name(g.midiNote), midi_note_octave(g.midiNote));
+		if (g.sustain)
+			song.measures[g.measure].notesToAdd.emplace_back(freq, g.duration, g.offset, SUS_NOTE);
+		else
+			song.measures[g.measure].notesToAdd.emplace_back(freq, g.duration, g.offset);
+	}
+
+	return song;
+}
+
+// writes a generated song out as a .songdef file that can replace Song.songdef
+// @return whether the file could be written
+static bool write_songdef(const char* filename, const GeneratorParams& params, const std::string& name)
+{
+	std::ofstream out(filename);
+	if (!out)
+		return false;
+
+	std::vector<GeneratedNote> notes = generate_notes(params);
+
+	out << "// generated: " << params.voices << " voices, " << params.notesPerMeasure << " notes per measure, "
+		<< params.sustainRatio << " sustain ratio, " << params.measures << " measures, seed " << params.seed << "\n";
+	out << "{\n\t\"" << name << "\",\n\t{\n";
+
+	size_t next = 0;
+	for (unsigned m = 0; m < params.measures; ++m)
+	{
+		out << "\t\t/*" << m + 1 << "*/ MEASURE( ";
+		bool first = true;
+		for (; next < notes.size() && notes[next].measure == m; ++next)
+		{
+			const GeneratedNote& g = notes[next];
+			out << (first ? "" : ", ") << "NOTE(" << midi_note_name(g.midiNote) << ", " << midi_note_octave(g.midiNote)
+				<< ", " << g.duration << ", " << g.offset << (g.sustain ? ", SUS_NOTE" : "") << ")";
+			first = false;
+		}
+		out << " )" << (m + 1 < params.measures ? "," : "") << "\n";
+	}
+
+	out << "\t}\n};\n";
+	return static_cast<bool>(out);
+}
+
+// generates a format 1 MIDI file of a song: a tempo track followed by one track per voice
+// @param tempoMap: change the tempo every 4 measures (cycling through 100%, 80%, 100% and 125% of the song's tempo)
+static std::vector<unsigned char> generate_midi(const GeneratorParams& params, bool tempoMap = true)
+{
+	const unsigned division = 480;	// ticks per quarter note
+	std::vector<GeneratedNote> notes = generate_notes(params);
+
+	std::vector<unsigned char> out;
+	auto put16 = [&](unsigned v) { out.push_back(static_cast<unsigned char>(v >> 8)); out.push_back(static_cast<unsigned char>(v)); };
+	auto put32 = [&](unsigned v) { put16(v >> 16); put16(v & 0xFFFF); };
+	auto put_vlq = [](std::vector<unsigned char>& track, unsigned v)
+	{
+		unsigned char bytes[5];
+		int n = 0;
+		do { bytes[n++] = static_cast<unsigned char>(v & 0x7F); v >>= 7; } while (v);
+		while (n-- > 0)
+			track.push_back(static_cast<unsigned char>(bytes[n] | (n ? 0x80 : 0)));
+	};
+
+	// each track is a list of events at absolute ticks: note offs sort before note ons on the same tick
+	struct Event { unsigned tick; unsigned char bytes[6]; unsigned char size; };
+	auto write_track = [&](std::vector<Event>& events)
+	{
+		std::stable_sort(events.begin(), events.end(), [](const Event& a, const Event& b) { return a.tick < b.tick; });
+		std::vector<unsigned char> track;
+		unsigned tick = 0;
+		for (const Event& e : events)
+		{
+			put_vlq(track, e.tick - tick);
+			track.insert(track.end(), e.bytes, e.bytes + e.size);
+			tick = e.tick;
+		}
+		const unsigned char endOfTrack[4] = { 0x00, 0xFF, 0x2F, 0x00 };
+		track.insert(track.end(), endOfTrack, endOfTrack + 4);
+
+		out.insert(out.end(), { 'M', 'T', 'r', 'k' });
+		put32(static_cast<unsigned>(track.size()));
+		out.insert(out.end(), track.begin(), track.end());
+	};
+
+	// header
+	out.insert(out.end(), { 'M', 'T', 'h', 'd' });
+	put32(6);
+	put16(1);
+	put16(params.voices + 1);
+	put16(division);
+
+	// tempo track
+	std::vector<Event> tempos;
+	const double percents[4] = { 1.0, 0.8, 1.0, 1.25 };
+	for (unsigned m = 0; m < (tempoMap ? params.measures : 1u); m += 4)
+	{
+		unsigned tempo = static_cast<unsigned>(1.0e6 * QUARTER_NOTE / percents[(m / 4) % 4]);
+		Event e = { m * 4 * division, { 0xFF, 0x51, 0x03, static_cast<unsigned char>(tempo >> 16),
+			static_cast<unsigned char>(tempo >> 8), static_cast<unsigned char>(tempo) }, 6 };
+		tempos.push_back(e);
+	}
+	write_track(tempos);
+
+	// voice tracks, each on its own channel (skipping the percussion channel)
+	std::vector<std::vector<Event>> tracks(params.voices);
+	for (const GeneratedNote& g : notes)
+	{
+		unsigned char channel = static_cast<unsigned char>(g.voice % 15);
+		channel += (channel >= 9) ? 1 : 0;
+		unsigned start = static_cast<unsigned>((4.f * g.measure + g.offset) * division + 0.5f);
+		unsigned end = start + static_cast<unsigned>(g.duration * division + 0.5f);
+		Event on = { start, { static_cast<unsigned char>(0x90 | channel), static_cast<unsigned char>(g.midiNote), 96 }, 3 };
+		Event off = { end, { static_cast<unsigned char>(0x80 | channel), static_cast<unsigned char>(g.midiNote), 0 }, 3 };
+		tracks[g.voice].push_back(off);
+		tracks[g.voice].push_back(on);
+	}
+	for (std::vector<Event>& track : tracks)
+		write_track(track);
+
+	return out;
+}
+
+// writes a generated song out as a MIDI file
+// @return whether the file could be written
+static bool write_midi(const char* filename, const GeneratorParams& params, bool tempoMap = true)
+{
+	std::ofstream out(filename, std::ios_base::binary);
+	if (!out)
+		return false;
+
+	std::vector<unsigned char> bytes = generate_midi(params, tempoMap);
+	out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+	return static_cast<bool>(out);
+}
+
+#endif //__MAT320_SONG_GENERATOR_H
+
+/*
+	------------------------------------------------------------------------------
+	This software is available under 2 licenses - you may choose the one you like.
+	------------------------------------------------------------------------------
+	ALTERNATIVE A - zlib license
+	Copyright (c) 2019 Matthew Rosen
+	This software is provided 'as-is', without any express or implied warranty.
+	In no event will the authors be held liable for any damages arising from
+	the use of this software.
+	Permission is granted to anyone to use this software for any purpose,
+	including commercial applications, and to alter it and redistribute it
+	freely, subject to the following restrictions:
+	  1. The origin of this software must not be misrepresented; you must not
+		 claim that you wrote the original software. If you use this software
+		 in a product, an acknowledgment in the product documentation would be
+		 appreciated but is not required.
+	  2. Altered source versions must be plainly marked as such, and must not
+		 be misrepresented as being the original software.
+	  3. This notice may not be removed or altered from any source distribution.
+	------------------------------------------------------------------------------
+	ALTERNATIVE B - Public Domain (www.unlicense.org)
+	This is free and unencumbered software released into the public domain.
+	Anyone is free to copy, modify, publish, use, compile, sell, or distribute this
+	software, either in source code form or as a compiled binary, for any purpose,
+	commercial or non-commercial, and by any means.
+	In jurisdictions that recognize copyright laws, the author or authors of this
+	software dedicate any and all copyright interest in the software to the public
+	domain. We make this dedication for the benefit of the public at large and to
+	the detriment of our heirs and successors. We intend this dedication to be an
+	overt act of relinquishment in perpetuity of all present and future rights to
+	this software under copyright law.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+	ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+	WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+	------------------------------------------------------------------------------
+*/
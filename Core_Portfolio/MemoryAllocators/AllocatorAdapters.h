@@ -0,0 +1,201 @@
+//Matthew Rosen
+#pragma once
+
+#include "SizeClassAllocator.h"
+#include "StackAllocator.h"
+
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+
+// adapters that let standard containers use the allocators
+//
+// STL allocators (pass as the container's Allocator parameter):
+//	* SizeClassStlAllocator<T> allocates from a SizeClassAllocator, so node based containers
+//	  (list, map, unordered_set, ...) get their nodes from pools, whatever the node type is
+//	* StackStlAllocator<T> allocates from a StackAllocator and never frees,
+//	  memory comes back when the stack is rolled back (use with StackFrame or Clear)
+//
+// std::pmr::memory_resource wrappers (for std::pmr containers):
+//	* PoolResource: pooled, over a SizeClassAllocator
+//	* MonotonicStackResource: monotonic, over a StackAllocator
+//
+//	SizeClassAllocator<> pool;
+//	std::unordered_set<int, std::hash<int>, std::equal_to<int>, SizeClassStlAllocator<int>> set{ SizeClassStlAllocator<int>(pool) };
+//
+//	PoolResource<> resource(pool);
+//	std::pmr::unordered_set<int> pmrSet(&resource);
+
+// whether a size class block of bytes is aligned enough
+// (blocks are aligned to 8, or 16 when their size is a multiple of 16)
+inline bool SizeClassAligns(size_t bytes, size_t alignment)
+{
+	return alignment <= 8 || (alignment == 16 && bytes % 16 == 0);
+}
+
+// allocate from a size class allocator, or from the system if it's over aligned
+template<typename Backing>
+void* AllocAlignedFrom(Backing& allocator, size_t bytes, size_t alignment)
+{
+	if (SizeClassAligns(bytes, alignment))
+		return allocator.Alloc(bytes);
+	return ::operator new(bytes, std::align_val_t(alignment));
+}
+
+// free memory from AllocAlignedFrom, with the same bytes and alignment
+template<typename Backing>
+void FreeAlignedTo(Backing& allocator, void* address, size_t bytes, size_t alignment)
+{
+	if (SizeClassAligns(bytes, alignment))
+		allocator.Free(address, bytes);
+	else
+		::operator delete(address, std::align_val_t(alignment));
+}
+
+// STL allocator over a SizeClassAllocator
+template<typename T, typename ThreadPolicy = SingleThreaded>
+class SizeClassStlAllocator
+{
+public:
+	typedef T value_type;
+	typedef SizeClassAllocator<ThreadPolicy> Backing;
+
+	explicit SizeClassStlAllocator(Backing& allocator) noexcept
+		: m_allocator(&allocator) {}
+
+	// rebind copy, containers allocate nodes of a different type than T
+	template<typename U>
+	SizeClassStlAllocator(const SizeClassStlAllocator<U, ThreadPolicy>& rhs) noexcept
+		: m_allocator(rhs.GetBacking()) {}
+
+	T* allocate(size_t n)
+	{
+		return static_cast<T*>(AllocAlignedFrom(*m_allocator, n * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T* address, size_t n) noexcept
+	{
+		FreeAlignedTo(*m_allocator, address, n * sizeof(T), alignof(T));
+	}
+
+	Backing* GetBacking() const noexcept
+	{
+		return m_allocator;
+	}
+
+private:
+	Backing* m_allocator;	// size class allocator the memory comes from
+};
+
+template<typename T, typename U, typename ThreadPolicy>
+bool operator==(const SizeClassStlAllocator<T, ThreadPolicy>& lhs, const SizeClassStlAllocator<U, ThreadPolicy>& rhs) noexcept
+{
+	return lhs.GetBacking() == rhs.GetBacking();
+}
+
+template<typename T, typename U, typename ThreadPolicy>
+bool operator!=(const SizeClassStlAllocator<T, ThreadPolicy>& lhs, const SizeClassStlAllocator<U, ThreadPolicy>& rhs) noexcept
+{
+	return !(lhs == rhs);
+}
+
+// STL allocator over a StackAllocator, deallocate does nothing
+// good for containers that are built, used and thrown away within one frame
+template<typename T>
+class StackStlAllocator
+{
+public:
+	typedef T value_type;
+
+	explicit StackStlAllocator(StackAllocator& stack) noexcept
+		: m_stack(&stack) {}
+
+	template<typename U>
+	StackStlAllocator(const StackStlAllocator<U>& rhs) noexcept
+		: m_stack(rhs.GetBacking()) {}
+
+	T* allocate(size_t n)
+	{
+		return static_cast<T*>(m_stack->AllocAligned(n * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T*, size_t) noexcept
+	{
+		// memory comes back when the stack is rolled back
+	}
+
+	StackAllocator* GetBacking() const noexcept
+	{
+		return m_stack;
+	}
+
+private:
+	StackAllocator* m_stack;	// stack the memory comes from
+};
+
+template<typename T, typename U>
+bool operator==(const StackStlAllocator<T>& lhs, const StackStlAllocator<U>& rhs) noexcept
+{
+	return lhs.GetBacking() == rhs.GetBacking();
+}
+
+template<typename T, typename U>
+bool operator!=(const StackStlAllocator<T>& lhs, const StackStlAllocator<U>& rhs) noexcept
+{
+	return !(lhs == rhs);
+}
+
+// pooled memory resource over a SizeClassAllocator
+template<typename ThreadPolicy = SingleThreaded>
+class PoolResource : public std::pmr::memory_resource
+{
+public:
+	typedef SizeClassAllocator<ThreadPolicy> Backing;
+
+	explicit PoolResource(Backing& allocator)
+		: m_allocator(allocator) {}
+
+private:
+	void* do_allocate(size_t bytes, size_t alignment) override
+	{
+		return AllocAlignedFrom(m_allocator, bytes, alignment);
+	}
+
+	void do_deallocate(void* address, size_t bytes, size_t alignment) override
+	{
+		FreeAlignedTo(m_allocator, address, bytes, alignment);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& rhs) const noexcept override
+	{
+		return this == &rhs;
+	}
+
+	Backing& m_allocator;	// size class allocator the memory comes from
+};
+
+// monotonic memory resource over a StackAllocator, deallocate does nothing
+class MonotonicStackResource : public std::pmr::memory_resource
+{
+public:
+	explicit MonotonicStackResource(StackAllocator& stack)
+		: m_stack(stack) {}
+
+private:
+	void* do_allocate(size_t bytes, size_t alignment) override
+	{
+		return m_stack.AllocAligned(bytes, alignment);
+	}
+
+	void do_deallocate(void*, size_t, size_t) override
+	{
+		// memory comes back when the stack is rolled back
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& rhs) const noexcept override
+	{
+		return this == &rhs;
+	}
+
+	StackAllocator& m_stack;	// stack the memory comes from
+};
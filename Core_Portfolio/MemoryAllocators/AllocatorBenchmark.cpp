@@ -0,0 +1,706 @@
+//Matthew Rosen
+// benchmarks for the memory allocators
+// build: g++ -std=c++17 -O2 -DNDEBUG -pthread AllocatorBenchmark.cpp -o AllocatorBenchmark
+// usage: AllocatorBenchmark [patterns | threads | arenas | batch | all]
+//	patterns: LIFO, FIFO, random order, burst/drain and producer/consumer,
+//	          for several object sizes, against system malloc
+//	threads:  thread scaling of the lock free pool and thread caches
+//	arenas:   startup time, RSS and access time of big stacks from malloc and OS backed arenas
+//	batch:    spawning and despawning groups of objects with batch calls against one call each
+
+#include "PoolAllocator.h"
+#include "StackAllocator.h"
+#include "MagazineCache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+// typical small game object, 32 bytes
+struct Particle
+{
+	float position[3];
+	float velocity[3];
+	unsigned owner;		// thread that allocated it, checked before it's freed
+	unsigned age;
+};
+
+// set if a thread found an object overwritten by another thread
+static std::atomic<bool> s_corrupted(false);
+
+// time one steady_clock read takes, in ns (a timed operation includes about one read)
+static double TimerOverhead()
+{
+	const unsigned reads = 100000;
+	std::chrono::steady_clock::now();
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned i = 0; i < reads; ++i)
+		std::chrono::steady_clock::now();
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(end - start).count() / reads;
+}
+
+// runs body(threadIndex) on numThreads threads, all released at once
+// returns the wall clock seconds until the last one finished
+template<typename Body>
+static double RunThreads(unsigned numThreads, Body body)
+{
+	std::atomic<unsigned> ready(0);
+	std::atomic<bool> go(false);
+	std::vector<std::thread> threads;
+	for (unsigned t = 0; t < numThreads; ++t)
+	{
+		threads.emplace_back([&, t]()
+		{
+			++ready;
+			while (!go.load(std::memory_order_acquire))
+				std::this_thread::yield();
+			body(t);
+		});
+	}
+
+	while (ready.load() != numThreads)
+		std::this_thread::yield();
+	auto start = std::chrono::steady_clock::now();
+	go.store(true, std::memory_order_release);
+	for (std::thread& thread : threads)
+		thread.join();
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double>(end - start).count();
+}
+
+// each thread allocates a burst of objects, checks them, then frees them, over and over
+// alloc and free take the thread index and return or take a Particle*
+template<typename AllocFn, typename FreeFn>
+static void Bursts(unsigned thread, unsigned burst, unsigned rounds, AllocFn alloc, FreeFn free)
+{
+	std::vector<Particle*> objects(burst);
+	for (unsigned r = 0; r < rounds; ++r)
+	{
+		for (unsigned i = 0; i < burst; ++i)
+		{
+			objects[i] = alloc(thread);
+			objects[i]->owner = thread;
+		}
+		for (unsigned i = 0; i < burst; ++i)
+		{
+			if (objects[i]->owner != thread)
+				s_corrupted = true;
+			free(thread, objects[i]);
+		}
+	}
+}
+
+// thread scaling benchmark: system malloc, the lock free pool, and the pool with thread caches
+static void ThreadScaling()
+{
+	const unsigned burst = 64;
+	const unsigned rounds = 1500;
+	const double opsPerThread = 2.0 * burst * rounds;
+
+	std::printf("thread scaling: bursts of %u allocs then %u frees, %u rounds per thread (Mops/s)\n", burst, burst, rounds);
+	std::printf("%8s %12s %12s %12s %20s\n", "threads", "malloc", "pool", "cached pool", "depot trips/1k ops");
+
+	for (unsigned numThreads = 1; numThreads <= 64; numThreads *= 2)
+	{
+		const double ops = opsPerThread * numThreads;
+		const unsigned maxObjects = numThreads * burst;
+
+		double mallocSeconds = RunThreads(numThreads, [&](unsigned t)
+		{
+			Bursts(t, burst, rounds,
+				[](unsigned) { return static_cast<Particle*>(std::malloc(sizeof(Particle))); },
+				[](unsigned, Particle* p) { std::free(p); });
+		});
+
+		PoolAllocator<Particle, LockFree> pool(maxObjects);
+		double poolSeconds = RunThreads(numThreads, [&](unsigned t)
+		{
+			Bursts(t, burst, rounds,
+				[&](unsigned) { return pool.Alloc(); },
+				[&](unsigned, Particle* p) { pool.Free(p); });
+		});
+
+		std::atomic<unsigned> depotTrips(0);
+		double cachedSeconds;
+		{
+			CachedPoolAllocator<Particle> cached(maxObjects);
+			cachedSeconds = RunThreads(numThreads, [&](unsigned t)
+			{
+				CachedPoolAllocator<Particle>::ThreadCache cache(cached);
+				Bursts(t, burst, rounds,
+					[&](unsigned) { return cache.Alloc(); },
+					[&](unsigned, Particle* p) { cache.Free(p); });
+				depotTrips += cache.DepotTrips();
+			});
+		}
+
+		std::printf("%8u %12.1f %12.1f %12.1f %20.2f\n", numThreads,
+			ops / mallocSeconds / 1.0e6, ops / poolSeconds / 1.0e6, ops / cachedSeconds / 1.0e6,
+			1000.0 * depotTrips / ops);
+	}
+}
+
+// resident set size of the process in bytes (0 where it isn't known)
+static size_t ResidentBytes()
+{
+#ifdef __linux__
+	long pages = 0, resident = 0;
+	FILE* statm = std::fopen("/proc/self/statm", "r");
+	if (statm)
+	{
+		if (std::fscanf(statm, "%ld %ld", &pages, &resident) != 2)
+			resident = 0;
+		std::fclose(statm);
+	}
+	return static_cast<size_t>(resident) * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+	return 0;
+#endif
+}
+
+// object of S bytes
+template<unsigned S>
+struct Block
+{
+	char bytes[S];
+};
+
+// the allocators under test, each with the same interface
+// LIFO_ONLY allocators can only run patterns that free in reverse order
+template<unsigned S>
+struct MallocBench
+{
+	typedef Block<S> Object;
+	static const bool LIFO_ONLY = false;
+	static const char* Name() { return "malloc"; }
+
+	explicit MallocBench(unsigned) {}
+	Object* Alloc() { return static_cast<Object*>(std::malloc(S)); }
+	void Free(Object* object) { std::free(object); }
+};
+
+template<unsigned S>
+struct PoolBench
+{
+	typedef Block<S> Object;
+	static const bool LIFO_ONLY = false;
+	static const char* Name() { return "pool"; }
+
+	explicit PoolBench(unsigned maxObjects) : pool(maxObjects) {}
+	Object* Alloc() { return pool.Alloc(); }
+	void Free(Object* object) { pool.Free(object); }
+
+	PoolAllocator<Object> pool;
+};
+
+template<unsigned S>
+struct StackBench
+{
+	typedef Block<S> Object;
+	static const bool LIFO_ONLY = true;
+	static const char* Name() { return "stack"; }
+
+	// no zero fill, as for frame scratch memory
+	// each object also takes its header byte, padded to the object's alignment
+	explicit StackBench(unsigned maxObjects) : stack(static_cast<size_t>(maxObjects) * (S + alignof(Object)), false) {}
+	Object* Alloc() { return stack.Alloc<Object>(); }
+	void Free(Object* object) { stack.Free(object); }
+
+	StackAllocator stack;
+};
+
+// single threaded allocation patterns
+enum Pattern
+{
+	patLifo,		// allocate all, free newest first
+	patFifo,		// allocate all, free oldest first
+	patRandom,		// allocate all, free in random order
+	patBurst,		// bursts of random size grow the live set and shrink it from the top
+	patCount
+};
+
+static const char* s_patternNames[patCount] = { "LIFO", "FIFO", "random", "burst/drain" };
+
+// runs each operation without timing it
+struct NoTimer
+{
+	template<typename Op>
+	void operator()(Op op) { op(); }
+};
+
+// times each operation
+struct LatencyTimer
+{
+	template<typename Op>
+	void operator()(Op op)
+	{
+		auto start = std::chrono::steady_clock::now();
+		op();
+		auto end = std::chrono::steady_clock::now();
+		ns.push_back(static_cast<float>(std::chrono::duration<double, std::nano>(end - start).count()));
+	}
+
+	// the p-th percentile, in ns
+	float Percentile(double p)
+	{
+		size_t i = std::min(ns.size() - 1, static_cast<size_t>(p / 100.0 * ns.size()));
+		std::nth_element(ns.begin(), ns.begin() + i, ns.end());
+		return ns[i];
+	}
+
+	std::vector<float> ns;	// time of each operation
+};
+
+// shared inputs of a pattern, so every allocator gets the same sequence
+struct PatternInput
+{
+	std::vector<unsigned> order;	// random free order
+	std::vector<unsigned> bursts;	// random burst sizes, 1 to 64
+};
+
+// runs a pattern once over objects.size() objects, returns the number of operations
+template<typename Bench, typename Timer>
+static size_t RunPattern(Bench& bench, Pattern pattern, const PatternInput& input,
+	std::vector<typename Bench::Object*>& objects, Timer& timer)
+{
+	const unsigned n = static_cast<unsigned>(objects.size());
+	size_t ops = 0;
+
+	auto alloc = [&](unsigned i)
+	{
+		timer([&]() { objects[i] = bench.Alloc(); objects[i]->bytes[0] = static_cast<char>(i); });
+		++ops;
+	};
+	auto free = [&](unsigned i)
+	{
+		timer([&]() { bench.Free(objects[i]); });
+		++ops;
+	};
+
+	if (pattern == patBurst)
+	{
+		// grow by bursts, freeing half of each burst again, then drain by bursts
+		unsigned live = 0;
+		size_t next = 0;
+		while (live < n)
+		{
+			unsigned burst = std::min(input.bursts[next++ % input.bursts.size()], n - live);
+			for (unsigned i = 0; i < burst; ++i)
+				alloc(live + i);
+			for (unsigned i = burst; i > burst - burst / 2; --i)
+				free(live + i - 1);
+			live += burst - burst / 2;
+		}
+		while (live > 0)
+		{
+			unsigned burst = std::min(input.bursts[next++ % input.bursts.size()], live);
+			for (unsigned i = 0; i < burst; ++i)
+				free(--live);
+		}
+		return ops;
+	}
+
+	for (unsigned i = 0; i < n; ++i)
+		alloc(i);
+	for (unsigned i = 0; i < n; ++i)
+	{
+		if (pattern == patLifo)
+			free(n - 1 - i);
+		else if (pattern == patFifo)
+			free(i);
+		else
+			free(input.order[i]);
+	}
+	return ops;
+}
+
+// benchmarks one allocator on one pattern: throughput, latency percentiles and RSS growth
+template<typename Bench>
+static void BenchPattern(Pattern pattern, const PatternInput& input, unsigned numObjects, unsigned repeats)
+{
+	if (Bench::LIFO_ONLY && (pattern == patFifo || pattern == patRandom))
+		return;
+
+	size_t residentBefore = ResidentBytes();
+	Bench bench(numObjects);
+	std::vector<typename Bench::Object*> objects(numObjects);
+
+	// warm up, then throughput
+	NoTimer untimed;
+	RunPattern(bench, pattern, input, objects, untimed);
+	size_t ops = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned r = 0; r < repeats; ++r)
+		ops += RunPattern(bench, pattern, input, objects, untimed);
+	auto end = std::chrono::steady_clock::now();
+	double seconds = std::chrono::duration<double>(end - start).count();
+	size_t residentAfter = ResidentBytes();
+
+	// latency of each operation
+	LatencyTimer timer;
+	timer.ns.reserve(4 * numObjects);
+	RunPattern(bench, pattern, input, objects, timer);
+
+	std::printf("%-12s %6zu %-8s %10.1f %8.0f %8.0f %8.0f %10zu\n", s_patternNames[pattern], sizeof(typename Bench::Object),
+		Bench::Name(), ops / seconds / 1.0e6, timer.Percentile(50.0), timer.Percentile(99.0), timer.Percentile(99.9),
+		(residentAfter > residentBefore ? residentAfter - residentBefore : 0) / 1024);
+}
+
+template<unsigned S>
+static void BenchPatternSize(Pattern pattern, const PatternInput& input, unsigned numObjects, unsigned repeats)
+{
+	BenchPattern<MallocBench<S>>(pattern, input, numObjects, repeats);
+	BenchPattern<PoolBench<S>>(pattern, input, numObjects, repeats);
+	BenchPattern<StackBench<S>>(pattern, input, numObjects, repeats);
+}
+
+// producer/consumer: one thread allocates objects and hands them to another that frees them
+template<typename AllocFn, typename FreeFn>
+static double ProducerConsumer(unsigned numObjects, AllocFn alloc, FreeFn free)
+{
+	// single producer, single consumer ring of objects
+	const unsigned RING_SIZE = 1024;
+	std::vector<std::atomic<void*>> ring(RING_SIZE);
+	std::atomic<unsigned> head(0), tail(0);
+
+	return RunThreads(2, [&](unsigned t)
+	{
+		if (t == 0)
+		{
+			for (unsigned i = 0; i < numObjects; ++i)
+			{
+				void* object = alloc(0);
+				static_cast<char*>(object)[0] = static_cast<char>(i);
+				while (head.load(std::memory_order_relaxed) - tail.load(std::memory_order_acquire) == RING_SIZE)
+					std::this_thread::yield();
+				unsigned h = head.load(std::memory_order_relaxed);
+				ring[h % RING_SIZE].store(object, std::memory_order_relaxed);
+				head.store(h + 1, std::memory_order_release);
+			}
+		}
+		else
+		{
+			for (unsigned i = 0; i < numObjects; ++i)
+			{
+				while (head.load(std::memory_order_acquire) == tail.load(std::memory_order_relaxed))
+					std::this_thread::yield();
+				unsigned t = tail.load(std::memory_order_relaxed);
+				void* object = ring[t % RING_SIZE].load(std::memory_order_relaxed);
+				tail.store(t + 1, std::memory_order_release);
+				free(1, object);
+			}
+		}
+	});
+}
+
+template<unsigned S>
+static void BenchProducerConsumer(unsigned numObjects)
+{
+	typedef Block<S> Object;
+	const double ops = 2.0 * numObjects;
+
+	double mallocSeconds = ProducerConsumer(numObjects,
+		[](unsigned) { return std::malloc(S); },
+		[](unsigned, void* object) { std::free(object); });
+	std::printf("%-12s %6u %-8s %10.1f\n", "prod/cons", S, "malloc", ops / mallocSeconds / 1.0e6);
+
+	PoolAllocator<Object, LockFree> pool(4096);
+	double poolSeconds = ProducerConsumer(numObjects,
+		[&](unsigned) { return static_cast<void*>(pool.Alloc()); },
+		[&](unsigned, void* object) { pool.Free(static_cast<Object*>(object)); });
+	std::printf("%-12s %6u %-8s %10.1f\n", "prod/cons", S, "pool", ops / poolSeconds / 1.0e6);
+
+	// the producer owns the pool, the consumer's frees go through the inbox
+	PoolAllocator<Object, ThreadOwned> owned(4096);
+	double ownedSeconds = ProducerConsumer(numObjects,
+		[&](unsigned) { return static_cast<void*>(owned.Alloc()); },
+		[&](unsigned, void* object) { owned.Free(static_cast<Object*>(object)); });
+	std::printf("%-12s %6u %-8s %10.1f\n", "prod/cons", S, "owned", ops / ownedSeconds / 1.0e6);
+
+	// each thread gets a cache, blocks flow from the consumer's cache back through the depot
+	CachedPoolAllocator<Object> cached(4096);
+	{
+		typename CachedPoolAllocator<Object>::ThreadCache producer(cached), consumer(cached);
+		typename CachedPoolAllocator<Object>::ThreadCache* caches[2] = { &producer, &consumer };
+		double cachedSeconds = ProducerConsumer(numObjects,
+			[&](unsigned t) { return static_cast<void*>(caches[t]->Alloc()); },
+			[&](unsigned t, void* object) { caches[t]->Free(static_cast<Object*>(object)); });
+		std::printf("%-12s %6u %-8s %10.1f\n", "prod/cons", S, "cached", ops / cachedSeconds / 1.0e6);
+	}
+}
+
+// allocation pattern benchmarks, single threaded then producer/consumer
+static void Patterns()
+{
+	const unsigned numObjects = 10000;
+	const unsigned repeats = 50;
+
+	PatternInput input;
+	std::mt19937 rng(320);
+	for (unsigned i = 0; i < numObjects; ++i)
+		input.order.push_back(i);
+	std::shuffle(input.order.begin(), input.order.end(), rng);
+	std::uniform_int_distribution<unsigned> burst(1, 64);
+	for (unsigned i = 0; i < 1024; ++i)
+		input.bursts.push_back(burst(rng));
+
+	std::printf("allocation patterns: %u objects, %u repeats (latency includes about %d ns of timer overhead)\n",
+		numObjects, repeats, static_cast<int>(TimerOverhead()));
+	std::printf("%-12s %6s %-8s %10s %8s %8s %8s %10s\n", "pattern", "size", "alloc", "Mops/s", "p50 ns", "p99 ns", "p99.9 ns", "RSS+ KB");
+	for (unsigned p = 0; p < patCount; ++p)
+	{
+		BenchPatternSize<16>(static_cast<Pattern>(p), input, numObjects, repeats);
+		BenchPatternSize<64>(static_cast<Pattern>(p), input, numObjects, repeats);
+		BenchPatternSize<256>(static_cast<Pattern>(p), input, numObjects, repeats);
+	}
+
+	BenchProducerConsumer<16>(1000000);
+	BenchProducerConsumer<64>(1000000);
+	BenchProducerConsumer<256>(1000000);
+	std::printf("\n");
+}
+
+// keeps reads from being optimized away
+static volatile unsigned long long s_sink;
+
+// makes a big stack, fills part of it with scratch data in frames, then clears it
+// reports construction time, RSS growth, fill time and RSS after Clear
+static void BenchArena(const char* name, StackAllocator* (*make)(size_t), size_t stackBytes, size_t usedBytes)
+{
+	const size_t chunk = 4096;
+	const unsigned frames = 8;
+	size_t residentBefore = ResidentBytes();
+
+	auto start = std::chrono::steady_clock::now();
+	StackAllocator* stack = make(stackBytes);
+	auto made = std::chrono::steady_clock::now();
+	size_t residentMade = ResidentBytes();
+
+	// fill the used part in 4 KB allocations, touching a cache line of each, frame after frame
+	unsigned long long sum = 0;
+	for (unsigned f = 0; f < frames; ++f)
+	{
+		StackFrame frame(*stack);
+		for (size_t used = 0; used + chunk <= usedBytes; used += chunk)
+		{
+			char* bytes = static_cast<char*>(frame.AllocAligned(chunk, 64));
+			for (unsigned i = 0; i < chunk; i += 256)
+			{
+				bytes[i] = static_cast<char>(i + f);
+				sum += bytes[(i + 4 * f) % chunk];
+			}
+		}
+	}
+	auto filled = std::chrono::steady_clock::now();
+	size_t residentFilled = ResidentBytes();
+
+	stack->Alloc<char>(static_cast<unsigned>(usedBytes));
+	stack->Clear();
+	size_t residentCleared = ResidentBytes();
+	delete stack;
+
+	std::printf("%-22s %10.2f %10zu %10.2f %10zu %10zu\n", name,
+		std::chrono::duration<double, std::milli>(made - start).count(), (residentMade - residentBefore) / 1024,
+		std::chrono::duration<double, std::milli>(filled - made).count() / frames, (residentFilled - residentBefore) / 1024,
+		(residentCleared > residentBefore ? residentCleared - residentBefore : 0) / 1024);
+	s_sink = sum;
+}
+
+typedef PoolAllocator<Block<64>> StartupPool;
+
+// makes a big pool, allocates part of it, then clears it
+// reports construction time, RSS growth, Clear time and RSS after Clear
+static void BenchPoolStartup(const char* name, StartupPool* (*make)(unsigned), unsigned numObjects, unsigned usedObjects)
+{
+	size_t residentBefore = ResidentBytes();
+
+	auto start = std::chrono::steady_clock::now();
+	StartupPool* pool = make(numObjects);
+	auto made = std::chrono::steady_clock::now();
+	size_t residentMade = ResidentBytes();
+
+	for (unsigned i = 0; i < usedObjects; ++i)
+		pool->Alloc()->bytes[0] = static_cast<char>(i);
+	size_t residentUsed = ResidentBytes();
+
+	auto clearing = std::chrono::steady_clock::now();
+	pool->Clear();
+	auto cleared = std::chrono::steady_clock::now();
+	size_t residentCleared = ResidentBytes();
+	delete pool;
+
+	std::printf("%-22s %10.2f %10zu %10zu %10.3f %10zu\n", name,
+		std::chrono::duration<double, std::milli>(made - start).count(), (residentMade - residentBefore) / 1024,
+		(residentUsed - residentBefore) / 1024, std::chrono::duration<double, std::milli>(cleared - clearing).count(),
+		(residentCleared > residentBefore ? residentCleared - residentBefore : 0) / 1024);
+}
+
+// big pools: threading every block up front, against handing out untouched blocks on demand
+static void BenchPoolStartups()
+{
+	const unsigned numObjects = 4 * 1024 * 1024;
+	const unsigned usedObjects = numObjects / 4;
+
+	std::printf("pools: %u MB of 64 byte blocks, %u MB used\n", (numObjects * 64) >> 20, (usedObjects * 64) >> 20);
+	std::printf("%-22s %10s %10s %10s %10s %10s\n", "backing", "make ms", "RSS+ KB", "used KB", "clear ms", "cleared KB");
+
+	BenchPoolStartup("heap, threaded", [](unsigned count)
+	{
+		// how the pool used to start: a free list through every block
+		// (untouched blocks are handed out in address order, so freeing them all threads the list)
+		StartupPool* pool = new StartupPool(count, false);
+		Block<64>* first = pool->Alloc();
+		for (unsigned i = 1; i < count; ++i)
+			pool->Alloc();
+		for (unsigned i = count; i-- > 0;)
+			pool->Free(first + i);
+		return pool;
+	}, numObjects, usedObjects);
+	BenchPoolStartup("heap, lazy", [](unsigned count) { return new StartupPool(count, false); }, numObjects, usedObjects);
+
+	BenchPoolStartup("arena, lazy", [](unsigned count)
+	{
+		ArenaOptions lazy;
+		lazy.releaseOnClear = true;
+		return new StartupPool(count, lazy);
+	}, numObjects, usedObjects);
+	std::printf("\n");
+}
+
+// big stacks from malloc and from OS backed arenas
+static void Arenas()
+{
+	const size_t stackBytes = 256 * 1024 * 1024;
+	const size_t usedBytes = 64 * 1024 * 1024;
+
+	std::printf("arenas: %zu MB stacks, %zu MB used per frame\n", stackBytes >> 20, usedBytes >> 20);
+	std::printf("%-22s %10s %10s %10s %10s %10s\n", "backing", "make ms", "RSS+ KB", "frame ms", "RSS+ KB", "cleared KB");
+
+	BenchArena("malloc + memset", [](size_t bytes)
+	{
+		// how the stack used to start: every page touched up front
+		StackAllocator* stack = new StackAllocator(bytes);
+		volatile char* memory = static_cast<char*>(stack->AllocAligned(bytes - 1, 1));	// all but the header byte
+		for (size_t i = 0; i < bytes - 1; i += 4096)
+			memory[i] = 0;
+		stack->Clear();
+		return stack;
+	}, stackBytes, usedBytes);
+	BenchArena("calloc", [](size_t bytes) { return new StackAllocator(bytes); }, stackBytes, usedBytes);
+
+	ArenaOptions lazy;
+	lazy.releaseOnClear = true;
+	static ArenaOptions s_options;
+	s_options = lazy;
+	BenchArena("arena, lazy", [](size_t bytes) { return new StackAllocator(bytes, s_options); }, stackBytes, usedBytes);
+
+	s_options.commit = acPopulate;
+	BenchArena("arena, populate", [](size_t bytes) { return new StackAllocator(bytes, s_options); }, stackBytes, usedBytes);
+
+	s_options = lazy;
+	s_options.hugePages = true;
+	BenchArena("arena, huge pages", [](size_t bytes) { return new StackAllocator(bytes, s_options); }, stackBytes, usedBytes);
+
+	s_options.commit = acPopulate;
+	BenchArena("arena, huge, populate", [](size_t bytes) { return new StackAllocator(bytes, s_options); }, stackBytes, usedBytes);
+	std::printf("\n");
+
+	BenchPoolStartups();
+}
+
+// spawns and despawns groups of count objects, rounds times, one call per object or one batch per group
+// returns ns per object
+template<typename ThreadPolicy>
+static double BenchBatchPolicy(unsigned count, unsigned rounds, bool batch)
+{
+	typedef Block<64> Object;
+	PoolAllocator<Object, ThreadPolicy> pool(4 * count);
+	std::vector<Object*> objects(count);
+	unsigned long long sum = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned r = 0; r < rounds; ++r)
+	{
+		if (batch)
+			pool.AllocBatch(objects.data(), count);
+		else
+		{
+			for (unsigned i = 0; i < count; ++i)
+				objects[i] = pool.Alloc();
+		}
+
+		for (unsigned i = 0; i < count; ++i)
+		{
+			objects[i]->bytes[0] = static_cast<char>(i);
+			sum += objects[i]->bytes[0];
+		}
+
+		if (batch)
+			pool.FreeBatch(objects.data(), count);
+		else
+		{
+			for (unsigned i = 0; i < count; ++i)
+				pool.Free(objects[i]);
+		}
+	}
+	auto end = std::chrono::steady_clock::now();
+	s_sink = sum;
+
+	return std::chrono::duration<double, std::nano>(end - start).count() / (2.0 * count * rounds);
+}
+
+template<typename ThreadPolicy>
+static void BenchBatchCount(const char* policy, unsigned count)
+{
+	const unsigned rounds = 20000000 / count;
+	double single = BenchBatchPolicy<ThreadPolicy>(count, rounds, false);
+	double batch = BenchBatchPolicy<ThreadPolicy>(count, rounds, true);
+	std::printf("%-14s %6u %12.2f %12.2f %8.2fx\n", policy, count, single, batch, single / batch);
+}
+
+// batch Alloc and Free against one call per object
+static void Batches()
+{
+	std::printf("batch: spawning and despawning groups of 64 byte objects (ns per call or per object)\n");
+	std::printf("%-14s %6s %12s %12s %9s\n", "policy", "group", "one by one", "batch", "speedup");
+	BenchBatchCount<SingleThreaded>("SingleThreaded", 16);
+	BenchBatchCount<SingleThreaded>("SingleThreaded", 256);
+	BenchBatchCount<SingleThreaded>("SingleThreaded", 4096);
+	BenchBatchCount<LockFree>("LockFree", 16);
+	BenchBatchCount<LockFree>("LockFree", 256);
+	BenchBatchCount<LockFree>("LockFree", 4096);
+	std::printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+	const char* which = argc > 1 ? argv[1] : "all";
+	bool all = std::strcmp(which, "all") == 0;
+
+	if (all || std::strcmp(which, "patterns") == 0)
+		Patterns();
+	if (all || std::strcmp(which, "threads") == 0)
+		ThreadScaling();
+	if (all || std::strcmp(which, "arenas") == 0)
+		Arenas();
+	if (all || std::strcmp(which, "batch") == 0)
+		Batches();
+
+	if (s_corrupted)
+	{
+		std::printf("an object was handed out to two threads at once!\n");
+		return 1;
+	}
+	return 0;
+}
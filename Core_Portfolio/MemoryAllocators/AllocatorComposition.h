@@ -0,0 +1,272 @@
+//Matthew Rosen
+#pragma once
+
+#include "PoolAllocator.h"
+#include "StackAllocator.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <mutex>
+#include <tuple>
+#include <utility>
+
+// building blocks for putting allocators together at compile time, in the style of
+// Alexandrescu's policy based allocators. every piece has the same interface:
+//	void* Allocate(size_t bytes);				nullptr if it can't serve the request
+//	void Deallocate(void* address, size_t bytes);	bytes must be the size passed to Allocate
+//	bool Owns(const void* address) const;		whether address came from this allocator
+//
+// leaves (PoolAllocatorImpl and StackAllocator have the interface too, these configure them
+// through template arguments, so a whole allocator is one type that's default constructible):
+//	* PoolLeaf<B, Count>: a pool of Count blocks of up to B bytes. with poFixed (the default) it
+//	  returns nullptr when it runs out, so behaviours like the pool's malloc fallback are composed instead
+//	* StackLeaf<Bytes>: a stack, Deallocate only frees the top allocation, the rest comes back on rollback
+//	* SystemAllocator: malloc and free, Owns claims everything so keep it last
+// combinators:
+//	* Fallback<Primary, Secondary>: tries Primary, then Secondary
+//	* Segregator<Threshold, Small, Large>: up to Threshold bytes go to Small, the rest to Large
+//	* Bucketizer<Bucket, Step, Max>: one Bucket<S> per size S = Step, 2 * Step, ... Max
+//	* Stats<Inner>: counts allocations and bytes going through Inner
+//	* Locked<Inner>: a mutex around Inner, for allocators shared between threads
+//
+// everything is resolved at compile time, there are no virtual calls or function pointers.
+// Owns of a paged pool reads the page header of the address, so only ask pools that never
+// see foreign addresses: put paged pools behind a Segregator or Bucketizer, not as a Fallback primary.
+//
+//	template<size_t S> using SmallPool = PoolLeaf<S, 1024>;
+//	typedef Locked<Segregator<128,
+//		Fallback<Bucketizer<SmallPool, 16, 128>, SystemAllocator>,
+//		Stats<SystemAllocator>>> EventAllocator;
+//	EventAllocator events;
+//	void* e = events.Allocate(sizeof(Event));
+//	events.Deallocate(e, sizeof(Event));
+
+// pool leaf of Count blocks of up to B bytes, aligned to 16 when B is a multiple of 16 (like malloc), else 8
+template<size_t B, unsigned Count, PoolOverflow Overflow = poFixed, typename ThreadPolicy = SingleThreaded>
+class PoolLeaf : public PoolAllocatorImpl<B, ThreadPolicy, (B % 16 == 0 ? 16 : 8)>
+{
+public:
+	PoolLeaf()
+		: PoolAllocatorImpl<B, ThreadPolicy, (B % 16 == 0 ? 16 : 8)>(Count, Overflow) {}
+};
+
+// stack leaf of Bytes bytes, freed bytes aren't reset to 0 unless ZeroOnFree
+template<size_t Bytes, bool ZeroOnFree = false>
+class StackLeaf : public StackAllocator
+{
+public:
+	StackLeaf()
+		: StackAllocator(Bytes, ZeroOnFree) {}
+};
+
+// system allocator leaf
+class SystemAllocator
+{
+public:
+	void* Allocate(size_t bytes)
+	{
+		return std::malloc(bytes ? bytes : 1);
+	}
+
+	void Deallocate(void* address, size_t)
+	{
+		std::free(address);
+	}
+
+	// malloc doesn't know its own blocks, so this claims everything
+	bool Owns(const void*) const
+	{
+		return true;
+	}
+};
+
+// tries Primary, and Secondary when Primary returns nullptr
+template<typename Primary, typename Secondary>
+class Fallback
+{
+public:
+	void* Allocate(size_t bytes)
+	{
+		void* address = m_primary.Allocate(bytes);
+		if (address == nullptr)
+			address = m_secondary.Allocate(bytes);
+		return address;
+	}
+
+	void Deallocate(void* address, size_t bytes)
+	{
+		if (m_primary.Owns(address))
+			m_primary.Deallocate(address, bytes);
+		else
+			m_secondary.Deallocate(address, bytes);
+	}
+
+	bool Owns(const void* address) const
+	{
+		return m_primary.Owns(address) || m_secondary.Owns(address);
+	}
+
+	Primary& GetPrimary() { return m_primary; }
+	Secondary& GetSecondary() { return m_secondary; }
+
+private:
+	Primary m_primary;		// tried first
+	Secondary m_secondary;	// gets what Primary can't serve
+};
+
+// sends requests of up to Threshold bytes to Small, bigger ones to Large
+// Deallocate picks the side by size too, so it never asks Owns
+template<size_t Threshold, typename Small, typename Large>
+class Segregator
+{
+public:
+	void* Allocate(size_t bytes)
+	{
+		return bytes <= Threshold ? m_small.Allocate(bytes) : m_large.Allocate(bytes);
+	}
+
+	void Deallocate(void* address, size_t bytes)
+	{
+		if (bytes <= Threshold)
+			m_small.Deallocate(address, bytes);
+		else
+			m_large.Deallocate(address, bytes);
+	}
+
+	bool Owns(const void* address) const
+	{
+		return m_small.Owns(address) || m_large.Owns(address);
+	}
+
+	Small& GetSmall() { return m_small; }
+	Large& GetLarge() { return m_large; }
+
+private:
+	Small m_small;	// up to Threshold bytes
+	Large m_large;	// the rest
+};
+
+// one Bucket<S> for each size S = Step, 2 * Step, ... up to Max, a request goes to the smallest that fits
+// requests over Max return nullptr (put a Bucketizer behind a Segregator, or in a Fallback).
+// the bucket is found with a chain of compares the compiler unrolls, so keep the number of buckets small
+template<template<size_t> class Bucket, size_t Step, size_t Max, typename = std::make_index_sequence<Max / Step>>
+class Bucketizer;
+
+template<template<size_t> class Bucket, size_t Step, size_t Max, size_t... I>
+class Bucketizer<Bucket, Step, Max, std::index_sequence<I...>>
+{
+	static_assert(Step > 0 && Max % Step == 0 && Max / Step > 0, "Bucketizer needs Max to be a multiple of Step!");
+
+public:
+	void* Allocate(size_t bytes)
+	{
+		void* address = nullptr;
+		(void)((bytes <= (I + 1) * Step ? (address = std::get<I>(m_buckets).Allocate(bytes), true) : false) || ...);
+		return address;
+	}
+
+	void Deallocate(void* address, size_t bytes)
+	{
+		(void)((bytes <= (I + 1) * Step ? (std::get<I>(m_buckets).Deallocate(address, bytes), true) : false) || ...);
+	}
+
+	bool Owns(const void* address) const
+	{
+		return (std::get<I>(m_buckets).Owns(address) || ...);
+	}
+
+	// bucket serving sizes up to (B + 1) * Step
+	template<size_t B>
+	Bucket<(B + 1) * Step>& GetBucket()
+	{
+		return std::get<B>(m_buckets);
+	}
+
+private:
+	std::tuple<Bucket<(I + 1) * Step>...> m_buckets;	// one allocator per size
+};
+
+// counts what goes through Inner: allocations, frees, failures and bytes.
+// not thread safe on its own, put it inside a Locked
+template<typename Inner>
+class Stats
+{
+public:
+	Stats()
+		: m_allocs(0), m_frees(0), m_failures(0), m_liveBytes(0), m_peakBytes(0) {}
+
+	void* Allocate(size_t bytes)
+	{
+		void* address = m_inner.Allocate(bytes);
+		if (address == nullptr)
+		{
+			++m_failures;
+			return nullptr;
+		}
+
+		++m_allocs;
+		m_liveBytes += bytes;
+		if (m_liveBytes > m_peakBytes)
+			m_peakBytes = m_liveBytes;
+		return address;
+	}
+
+	void Deallocate(void* address, size_t bytes)
+	{
+		++m_frees;
+		m_liveBytes -= bytes;
+		m_inner.Deallocate(address, bytes);
+	}
+
+	bool Owns(const void* address) const
+	{
+		return m_inner.Owns(address);
+	}
+
+	size_t Allocs() const { return m_allocs; }
+	size_t Frees() const { return m_frees; }
+	size_t Failures() const { return m_failures; }
+	size_t LiveBytes() const { return m_liveBytes; }
+	size_t PeakBytes() const { return m_peakBytes; }
+
+	Inner& GetInner() { return m_inner; }
+
+private:
+	Inner m_inner;			// allocator being counted
+	size_t m_allocs;		// successful allocations
+	size_t m_frees;			// frees
+	size_t m_failures;		// allocations Inner returned nullptr for
+	size_t m_liveBytes;		// bytes asked for and not freed yet
+	size_t m_peakBytes;		// most bytes live at once
+};
+
+// locks a mutex around every call to Inner, so any allocator can be shared between threads
+template<typename Inner, typename Mutex = std::mutex>
+class Locked
+{
+public:
+	void* Allocate(size_t bytes)
+	{
+		std::lock_guard<Mutex> lock(m_lock);
+		return m_inner.Allocate(bytes);
+	}
+
+	void Deallocate(void* address, size_t bytes)
+	{
+		std::lock_guard<Mutex> lock(m_lock);
+		m_inner.Deallocate(address, bytes);
+	}
+
+	bool Owns(const void* address) const
+	{
+		std::lock_guard<Mutex> lock(m_lock);
+		return m_inner.Owns(address);
+	}
+
+	// Inner without the lock, only use it while no other thread can
+	Inner& GetInner() { return m_inner; }
+
+private:
+	Inner m_inner;			// allocator being guarded
+	mutable Mutex m_lock;	// held for every call
+};
@@ -0,0 +1,241 @@
+//Matthew Rosen
+#pragma once
+
+// assertions and instrumentation shared by the allocators, both chosen at compile time:
+//	* ALLOCATOR_ASSERTS (on unless NDEBUG is defined): ASSERT prints the failed condition
+//	  and where it failed, then breaks into the debugger
+//	* ALLOCATOR_STATS (off by default): each allocator keeps an AllocatorStats with live and
+//	  peak counts, overflows, a high-water mark, an allocation size histogram, and the callsite
+//	  of every live allocation, dumped to stderr as a leak report when the allocator is destroyed.
+//	  when it's off, none of it is compiled in and tags cost nothing.
+//
+// to tag an allocation with its callsite, pass ALLOC_TAG:
+//	Particle* p = pool.Alloc(ALLOC_TAG);
+
+#include <cstddef>
+#include <cstdio>
+
+#ifndef ALLOCATOR_ASSERTS
+#ifdef NDEBUG
+#define ALLOCATOR_ASSERTS 0
+#else
+#define ALLOCATOR_ASSERTS 1
+#endif
+#endif
+
+#ifndef ALLOCATOR_STATS
+#define ALLOCATOR_STATS 0
+#endif
+
+#if ALLOCATOR_STATS
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#endif
+
+// prints a failed assertion, then breaks
+inline void AllocatorAssertFailed(const char* condition, const char* file, int line)
+{
+	std::fprintf(stderr, "allocator assertion failed: %s (%s:%d)\n", condition, file, line);
+#ifdef _MSC_VER
+	__debugbreak();
+#else
+	__builtin_trap();
+#endif
+}
+
+#if ALLOCATOR_ASSERTS
+#define ASSERT(condition) if((condition)) {} else { AllocatorAssertFailed(#condition, __FILE__, __LINE__); }
+#else
+#define ASSERT(condition) ((void)0)
+#endif
+
+// runs a statement only when stats are compiled in
+#if ALLOCATOR_STATS
+#define ALLOCATOR_STAT(statement) statement
+#else
+#define ALLOCATOR_STAT(statement)
+#endif
+
+// where an allocation was made, ALLOC_TAG makes one for the current line
+// an empty struct when stats are compiled out
+struct AllocTag
+{
+#if ALLOCATOR_STATS
+	AllocTag(const char* tagFile = nullptr, int tagLine = 0)
+		: file(tagFile), line(tagLine) {}
+
+	const char* file;	// source file, nullptr if untagged
+	int line;			// source line
+#else
+	AllocTag(const char* = nullptr, int = 0) {}
+#endif
+};
+
+#define ALLOC_TAG AllocTag(__FILE__, __LINE__)
+
+#if ALLOCATOR_STATS
+
+// statistics of one allocator, safe to update from any thread
+class AllocatorStats
+{
+public:
+	// bucket i counts allocations of [2^i, 2^(i+1)) bytes
+	static const unsigned HISTOGRAM_BUCKETS = 32;
+
+	explicit AllocatorStats(const char* name)
+		: m_name(name), m_live(0), m_peak(0), m_liveBytes(0), m_peakBytes(0),
+		m_allocs(0), m_overflows(0), m_highWater(0)
+	{
+		for (unsigned i = 0; i < HISTOGRAM_BUCKETS; ++i)
+			m_histogram[i] = 0;
+	}
+
+	AllocatorStats(const AllocatorStats&) = delete;
+	AllocatorStats& operator=(const AllocatorStats&) = delete;
+
+	void OnAlloc(void* address, size_t bytes, AllocTag tag)
+	{
+		Max(m_peak, m_live.fetch_add(1, std::memory_order_relaxed) + 1);
+		Max(m_peakBytes, m_liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+		m_allocs.fetch_add(1, std::memory_order_relaxed);
+		m_histogram[Bucket(bytes)].fetch_add(1, std::memory_order_relaxed);
+
+		std::lock_guard<std::mutex> lock(m_lock);
+		LiveAllocation& live = m_liveAllocations[address];
+		live.bytes = bytes;
+		live.tag = tag;
+	}
+
+	void OnFree(void* address)
+	{
+		size_t bytes = 0;
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			auto it = m_liveAllocations.find(address);
+			if (it == m_liveAllocations.end())
+				return;
+			bytes = it->second.bytes;
+			m_liveAllocations.erase(it);
+		}
+		m_live.fetch_sub(1, std::memory_order_relaxed);
+		m_liveBytes.fetch_sub(bytes, std::memory_order_relaxed);
+	}
+
+	// frees every live allocation in [begin, end), for stacks rolling back
+	void OnFreeRange(const void* begin, const void* end)
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		for (auto it = m_liveAllocations.begin(); it != m_liveAllocations.end();)
+		{
+			if (it->first >= begin && it->first < end)
+			{
+				m_live.fetch_sub(1, std::memory_order_relaxed);
+				m_liveBytes.fetch_sub(it->second.bytes, std::memory_order_relaxed);
+				it = m_liveAllocations.erase(it);
+			}
+			else
+				++it;
+		}
+	}
+
+	// frees every live allocation, for allocators being cleared
+	void OnClear()
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_liveAllocations.clear();
+		m_live.store(0, std::memory_order_relaxed);
+		m_liveBytes.store(0, std::memory_order_relaxed);
+	}
+
+	// allocation that didn't fit in the allocator's own memory
+	void OnOverflow()
+	{
+		m_overflows.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// bytes in use, for allocators with a high-water mark
+	void OnUsed(size_t bytes)
+	{
+		Max(m_highWater, bytes);
+	}
+
+	size_t Live() const { return m_live.load(std::memory_order_relaxed); }
+	size_t Peak() const { return m_peak.load(std::memory_order_relaxed); }
+	size_t LiveBytes() const { return m_liveBytes.load(std::memory_order_relaxed); }
+	size_t PeakBytes() const { return m_peakBytes.load(std::memory_order_relaxed); }
+	size_t TotalAllocs() const { return m_allocs.load(std::memory_order_relaxed); }
+	size_t Overflows() const { return m_overflows.load(std::memory_order_relaxed); }
+	size_t HighWater() const { return m_highWater.load(std::memory_order_relaxed); }
+	size_t Histogram(unsigned bucket) const { return m_histogram[bucket].load(std::memory_order_relaxed); }
+
+	void Report(FILE* file) const
+	{
+		std::fprintf(file, "%s: %zu live (peak %zu), %zu bytes live (peak %zu), %zu allocs, %zu overflows",
+			m_name, Live(), Peak(), LiveBytes(), PeakBytes(), TotalAllocs(), Overflows());
+		if (HighWater())
+			std::fprintf(file, ", high-water mark %zu bytes", HighWater());
+		std::fprintf(file, "\n");
+
+		for (unsigned i = 0; i < HISTOGRAM_BUCKETS; ++i)
+		{
+			if (Histogram(i))
+				std::fprintf(file, "\t%zu to %zu bytes: %zu\n", i ? size_t(1) << i : 0, (size_t(1) << (i + 1)) - 1, Histogram(i));
+		}
+	}
+
+	// prints every live allocation with its callsite, returns the number of leaks
+	size_t ReportLeaks(FILE* file) const
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		if (m_liveAllocations.empty())
+			return 0;
+
+		std::fprintf(file, "%s: %zu allocations leaked\n", m_name, m_liveAllocations.size());
+		for (const auto& live : m_liveAllocations)
+		{
+			std::fprintf(file, "\t%p, %zu bytes, from %s:%d\n", live.first, live.second.bytes,
+				live.second.tag.file ? live.second.tag.file : "(untagged)", live.second.tag.line);
+		}
+		return m_liveAllocations.size();
+	}
+
+private:
+	struct LiveAllocation
+	{
+		size_t bytes;
+		AllocTag tag;
+	};
+
+	static unsigned Bucket(size_t bytes)
+	{
+		unsigned bucket = 0;
+		while (bytes > 1 && bucket < HISTOGRAM_BUCKETS - 1)
+		{
+			bytes >>= 1;
+			++bucket;
+		}
+		return bucket;
+	}
+
+	static void Max(std::atomic<size_t>& peak, size_t value)
+	{
+		size_t current = peak.load(std::memory_order_relaxed);
+		while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed))
+			;
+	}
+
+	const char* m_name;									// name used in reports
+	std::atomic<size_t> m_live;							// allocations not freed yet
+	std::atomic<size_t> m_peak;							// most allocations live at once
+	std::atomic<size_t> m_liveBytes;					// bytes not freed yet
+	std::atomic<size_t> m_peakBytes;					// most bytes live at once
+	std::atomic<size_t> m_allocs;						// total allocations
+	std::atomic<size_t> m_overflows;					// allocations past the allocator's own memory
+	std::atomic<size_t> m_highWater;					// most bytes in use at once
+	std::atomic<size_t> m_histogram[HISTOGRAM_BUCKETS];	// allocations by size
+	mutable std::mutex m_lock;							// guards m_liveAllocations
+	std::unordered_map<void*, LiveAllocation> m_liveAllocations;	// live allocations by address
+};
+
+#endif
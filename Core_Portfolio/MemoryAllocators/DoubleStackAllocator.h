@@ -0,0 +1,281 @@
+//Matthew Rosen
+#pragma once
+
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+#include "AllocatorDebug.h"
+#include "VirtualArena.h"
+
+// which end of a DoubleStackAllocator to use
+enum StackEnd
+{
+	seBottom,		// grows up from the bottom, for long lived data (e.g. loaded with a level)
+	seTop			// grows down from the top, for short lived data (e.g. per frame scratch)
+};
+
+// stack allocator with two ends in one block of memory
+// the bottom stack grows up and the top stack grows down, so both lifetimes share one block
+// sized for their combined worst case instead of each being sized for its own.
+// each end works like a StackAllocator: free in reverse order, or roll back to a marker,
+// and each end has its own markers. the ends only collide when the block is full,
+// which is checked in O(1) on every allocation.
+// like the StackAllocator, each allocation has a header byte holding how far it was moved to its
+// alignment: below it on the bottom end, above it on the top end.
+// Usage:
+//	DoubleStackAllocator memory(64 * 1024 * 1024);
+//	Mesh* mesh = memory.Construct<Mesh>(seBottom);		// lives until the level unloads
+//	DoubleStackAllocator::Marker frame = memory.GetMarker(seTop);
+//	float* scratch = memory.Alloc<float>(seTop, 1024);	// gone at the end of the frame
+//	memory.FreeToMarker(seTop, frame);
+class DoubleStackAllocator
+{
+public:
+	// saved top of one end, as an offset from the bottom of the block
+	typedef size_t Marker;
+
+	// largest alignment, so the distance an allocation is moved fits in its header byte
+	static const size_t MAX_ALIGNMENT = 128;
+
+	DoubleStackAllocator(size_t sizeInBytes, bool zeroOnFree = true)
+		: m_stackSize(sizeInBytes), m_zeroOnFree(zeroOnFree), m_arena(nullptr), m_releaseOnClear(false)
+	{
+		// calloc gets big blocks straight from the OS already zeroed, without touching every page
+		m_memStack = (char *)calloc(sizeInBytes ? sizeInBytes : 1, 1);
+		ASSERT(m_memStack);
+		m_bottomPtr = m_memStack;
+		m_topPtr = m_memStack + m_stackSize;
+	}
+
+	// double stack on an OS backed arena instead of malloc
+	DoubleStackAllocator(size_t sizeInBytes, const ArenaOptions& arena, bool zeroOnFree = true)
+		: m_stackSize(sizeInBytes), m_zeroOnFree(zeroOnFree), m_releaseOnClear(arena.releaseOnClear)
+	{
+		m_arena = new VirtualArena(sizeInBytes, arena);
+		m_memStack = m_arena->Base();
+		m_bottomPtr = m_memStack;
+		m_topPtr = m_memStack + m_stackSize;
+	}
+
+	~DoubleStackAllocator()
+	{
+		ALLOCATOR_STAT(m_stats.ReportLeaks(stderr));
+		ASSERT(m_bottomPtr <= m_topPtr && "The two ends of the stack overlap. This is really bad");
+
+		if (m_arena)
+		{
+			delete m_arena;
+			m_arena = nullptr;
+		}
+		else if (m_memStack)
+		{
+			free(m_memStack);
+		}
+		m_memStack = nullptr;
+
+		m_bottomPtr = nullptr;
+		m_topPtr = nullptr;
+		m_stackSize = 0;
+	}
+
+	DoubleStackAllocator(const DoubleStackAllocator&) = delete;
+	DoubleStackAllocator& operator=(const DoubleStackAllocator&) = delete;
+
+	template<typename T>
+	T* Alloc(StackEnd end, unsigned numElements = 1, AllocTag tag = AllocTag())
+	{
+		return reinterpret_cast<T*>(AllocAligned(end, sizeof(T) * numElements, alignof(T), tag));
+	}
+
+	// allocate bytes aligned to alignment (a power of 2) from one end
+	// tag is the callsite (ALLOC_TAG), only kept when ALLOCATOR_STATS is on
+	void* AllocAligned(StackEnd end, size_t bytes, size_t alignment, AllocTag tag = AllocTag())
+	{
+		(void)tag;
+		ASSERT(alignment && (alignment & (alignment - 1)) == 0 && "Alignment must be a power of 2!");
+		ASSERT(alignment <= MAX_ALIGNMENT && "Alignment is too big for the stack's header byte!");
+
+		uintptr_t top = reinterpret_cast<uintptr_t>(end == seBottom ? m_bottomPtr : m_topPtr);
+		char* mem;
+		if (end == seBottom)
+		{
+			// round top of the bottom stack + 1 up to the alignment, leaving room for the header byte below
+			size_t adjustment = ((top + alignment) & ~(alignment - 1)) - top;
+
+			// ensure the allocation doesn't run into the top stack
+			ASSERT(adjustment <= (size_t)(m_topPtr - m_bottomPtr) && bytes <= (size_t)(m_topPtr - m_bottomPtr) - adjustment &&
+				"Allocation too big, the two ends of the stack would overlap!");
+
+			// remember how far the allocation was moved up, Free moves back down by as much
+			mem = m_bottomPtr + adjustment;
+			reinterpret_cast<unsigned char*>(mem)[-1] = static_cast<unsigned char>(adjustment);
+
+			// set top of the bottom stack to be where this allocation ends
+			m_bottomPtr = mem + bytes;
+		}
+		else
+		{
+			// ensure the allocation and its header byte don't run into the bottom stack
+			ASSERT(bytes < (size_t)(m_topPtr - m_bottomPtr) && "Allocation too big, the two ends of the stack would overlap!");
+
+			// move the top stack down past the header byte and the allocation, then round down to the alignment
+			size_t adjustment = ((top - bytes - 1) & (alignment - 1)) + 1;
+			ASSERT(adjustment <= (size_t)(m_topPtr - m_bottomPtr) - bytes && "Allocation too big, the two ends of the stack would overlap!");
+
+			// remember how far the allocation was moved down, Free moves back up by as much
+			mem = m_topPtr - bytes - adjustment;
+			reinterpret_cast<unsigned char*>(mem)[bytes] = static_cast<unsigned char>(adjustment);
+
+			// set top of the top stack to be where this allocation starts
+			m_topPtr = mem;
+		}
+
+		ALLOCATOR_STAT(m_stats.OnAlloc(mem, bytes, tag));
+		ALLOCATOR_STAT(m_stats.OnUsed(m_stackSize - (m_topPtr - m_bottomPtr)));
+
+		return mem;
+	}
+
+	template<typename T, typename... Args>
+	T* Construct(StackEnd end, Args... args)
+	{
+		// allocate object on one end, then in-place construct it
+		return new (Alloc<T>(end)) T(args...);
+	}
+
+	template<typename T>
+	void Free(StackEnd end, T* address, unsigned numElements = 1)
+	{
+		FreeAligned(end, address, sizeof(T) * numElements);
+	}
+
+	// free bytes allocated by AllocAligned from the same end
+	void FreeAligned(StackEnd end, void* address, size_t bytes)
+	{
+		char* mem = (char*)address;
+		ASSERT(mem);
+		ALLOCATOR_STAT(m_stats.OnFree(address));
+
+		// reclaimed range: the allocation, its header byte and its padding
+		char* begin;
+		char* finish;
+		if (end == seBottom)
+		{
+			// assure address is the top allocation of the bottom stack
+			ASSERT(mem + bytes == m_bottomPtr && "Freeing an allocation that isn't on top of the bottom stack!");
+			begin = mem - reinterpret_cast<unsigned char*>(mem)[-1];
+			finish = mem + bytes;
+			m_bottomPtr = begin;
+		}
+		else
+		{
+			// assure address is the bottom allocation of the top stack
+			ASSERT(mem == m_topPtr && "Freeing an allocation that isn't on top of the top stack!");
+			begin = mem;
+			finish = mem + bytes + reinterpret_cast<unsigned char*>(mem)[bytes];
+			m_topPtr = finish;
+		}
+
+		// reset bytes to 0 in reclaimed memory
+		if (m_zeroOnFree)
+			std::memset(begin, 0, finish - begin);
+	}
+
+	template<typename T>
+	void Destruct(StackEnd end, T* address, unsigned numElements = 1)
+	{
+		ASSERT(address);
+
+		// call dtor on each element in allocated array (works for non-arrays as well)
+		for (unsigned i = 0; i < numElements; ++i)
+			address[i].~T();
+
+		Free(end, address, numElements);
+	}
+
+	// current top of one end
+	Marker GetMarker(StackEnd end) const
+	{
+		return (end == seBottom ? m_bottomPtr : m_topPtr) - m_memStack;
+	}
+
+	// free everything allocated on one end since marker was taken, in one step
+	void FreeToMarker(StackEnd end, Marker marker)
+	{
+		char* markerPtr = m_memStack + marker;
+		char* begin;
+		char* finish;
+		if (end == seBottom)
+		{
+			ASSERT(markerPtr <= m_bottomPtr && "Marker is above the bottom stack, it was already freed past!");
+			begin = markerPtr;
+			finish = m_bottomPtr;
+			m_bottomPtr = markerPtr;
+		}
+		else
+		{
+			ASSERT(markerPtr >= m_topPtr && markerPtr <= m_memStack + m_stackSize &&
+				"Marker is below the top stack, it was already freed past!");
+			begin = m_topPtr;
+			finish = markerPtr;
+			m_topPtr = markerPtr;
+		}
+		ALLOCATOR_STAT(m_stats.OnFreeRange(begin, finish));
+
+		// reset bytes to 0 in reclaimed memory
+		if (m_zeroOnFree)
+			std::memset(begin, 0, finish - begin);
+	}
+
+	// frees everything on one end, doesn't destruct any elements
+	void Clear(StackEnd end)
+	{
+		if (end == seBottom)
+		{
+			// give the used pages back to the OS, they read as zero when they're touched again
+			if (m_releaseOnClear)
+				m_arena->Release(0, m_bottomPtr - m_memStack);
+			ALLOCATOR_STAT(m_stats.OnFreeRange(m_memStack, m_bottomPtr));
+			m_bottomPtr = m_memStack;
+		}
+		else
+		{
+			if (m_releaseOnClear)
+				m_arena->Release(m_topPtr - m_memStack, m_memStack + m_stackSize - m_topPtr);
+			ALLOCATOR_STAT(m_stats.OnFreeRange(m_topPtr, m_memStack + m_stackSize));
+			m_topPtr = m_memStack + m_stackSize;
+		}
+	}
+
+	// frees everything on both ends
+	void Clear()
+	{
+		Clear(seBottom);
+		Clear(seTop);
+	}
+
+	// bytes left between the two ends
+	size_t FreeBytes() const
+	{
+		return m_topPtr - m_bottomPtr;
+	}
+
+#if ALLOCATOR_STATS
+	const AllocatorStats& Stats() const
+	{
+		return m_stats;
+	}
+#endif
+
+private:
+	size_t m_stackSize;		// size of allocated block in bytes
+	char* m_memStack;		// ptr to bottom of the block
+	char* m_bottomPtr;		// ptr to current top of the bottom stack, it grows up
+	char* m_topPtr;			// ptr to current top of the top stack, it grows down
+	bool m_zeroOnFree;		// whether freed bytes are reset to 0
+	VirtualArena* m_arena;	// OS backed memory of the block, nullptr if it's from malloc
+	bool m_releaseOnClear;	// whether Clear gives used pages back to the OS
+	ALLOCATOR_STAT(AllocatorStats m_stats{ "DoubleStackAllocator" };)	// instrumentation, if compiled in
+};
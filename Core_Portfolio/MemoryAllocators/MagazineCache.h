@@ -0,0 +1,200 @@
+//Matthew Rosen
+#pragma once
+
+#include "PoolAllocator.h"
+
+// per thread caching layer over a lock free pool (magazines and a depot, like Bonwick's slab allocator)
+// each thread makes its own ThreadCache, which holds two magazines: small stacks of free blocks.
+// Alloc and Free only touch the thread's magazines, until both are empty (or both full).
+// then a whole magazine is swapped with the shared depot in one exchange,
+// so shared state is touched about once every M calls instead of every call.
+//
+// Usage:
+//	* make one ThreadCache per thread (thread_local, or on the worker's stack)
+//	* blocks can be freed to any thread's cache, not just the one that allocated them
+//	* destroy every ThreadCache before the CachedPoolAllocator
+template<typename T, unsigned M = 32>
+class CachedPoolAllocator
+{
+	static_assert(M > 0, "CachedPoolAllocator needs magazines of at least one block!");
+
+	// fixed size stack of free blocks
+	struct Magazine
+	{
+		FreeNode node;		// link in the depot, must be first
+		unsigned count;		// number of blocks in the magazine
+		T* rounds[M];		// free blocks
+	};
+
+public:
+	class ThreadCache
+	{
+	public:
+		explicit ThreadCache(CachedPoolAllocator& allocator)
+			: m_allocator(allocator), m_depotTrips(0)
+		{
+			m_loaded = m_allocator.NewMagazine();
+			m_previous = m_allocator.NewMagazine();
+		}
+
+		~ThreadCache()
+		{
+			// give back blocks to the pool and magazines to the depot
+			m_allocator.ReturnMagazine(m_loaded);
+			m_allocator.ReturnMagazine(m_previous);
+		}
+
+		ThreadCache(const ThreadCache&) = delete;
+		ThreadCache& operator=(const ThreadCache&) = delete;
+
+		T* Alloc()
+		{
+			// case loaded magazine has blocks (the common case)
+			if (m_loaded->count)
+				return m_loaded->rounds[--m_loaded->count];
+
+			// case previous magazine is full, swap it in
+			if (m_previous->count)
+			{
+				Swap();
+				return m_loaded->rounds[--m_loaded->count];
+			}
+
+			// case both empty, trade the empty previous magazine for a full one from the depot
+			++m_depotTrips;
+			Magazine* full = m_allocator.PopFull();
+			if (full)
+			{
+				m_allocator.PushEmpty(m_previous);
+				m_previous = m_loaded;
+				m_loaded = full;
+				return m_loaded->rounds[--m_loaded->count];
+			}
+
+			// case depot has no full magazines, refill half the loaded magazine from the pool
+			m_allocator.m_pool.AllocBatch(m_loaded->rounds, (M + 1) / 2);
+			m_loaded->count = (M + 1) / 2;
+			return m_loaded->rounds[--m_loaded->count];
+		}
+
+		template<typename... Args>
+		T* Construct(Args... args)
+		{
+			T* obj = Alloc();
+
+			// pass args to placement new
+			new (obj) T(args...);
+			return obj;
+		}
+
+		void Free(T* address)
+		{
+			// case loaded magazine has room (the common case)
+			if (m_loaded->count < M)
+			{
+				m_loaded->rounds[m_loaded->count++] = address;
+				return;
+			}
+
+			// case previous magazine is empty, swap it in
+			if (m_previous->count == 0)
+			{
+				Swap();
+				m_loaded->rounds[m_loaded->count++] = address;
+				return;
+			}
+
+			// case both full, give the full previous magazine to the depot for an empty one
+			++m_depotTrips;
+			m_allocator.PushFull(m_previous);
+			m_previous = m_loaded;
+			m_loaded = m_allocator.PopEmpty();
+			m_loaded->rounds[m_loaded->count++] = address;
+		}
+
+		void Destruct(T* address)
+		{
+			// destruct then free
+			address->~T();
+			Free(address);
+		}
+
+		// number of times this cache went to the depot
+		unsigned DepotTrips() const
+		{
+			return m_depotTrips;
+		}
+
+	private:
+		void Swap()
+		{
+			Magazine* temp = m_loaded;
+			m_loaded = m_previous;
+			m_previous = temp;
+		}
+
+		CachedPoolAllocator& m_allocator;	// allocator owning the pool and depot
+		Magazine* m_loaded;					// magazine Alloc and Free work on
+		Magazine* m_previous;				// full or empty magazine, swapped in when loaded runs out
+		unsigned m_depotTrips;				// times this cache exchanged with the depot
+	};
+
+	CachedPoolAllocator(unsigned maxObjects, bool allowExtraAllocations = true)
+		: m_pool(maxObjects, allowExtraAllocations) {}
+
+	~CachedPoolAllocator()
+	{
+		// give back blocks in full magazines, then delete every magazine
+		while (Magazine* full = PopFull())
+			ReturnMagazine(full);
+		while (Magazine* empty = PopEmpty(false))
+			delete empty;
+	}
+
+	CachedPoolAllocator(const CachedPoolAllocator&) = delete;
+	CachedPoolAllocator& operator=(const CachedPoolAllocator&) = delete;
+
+private:
+	Magazine* NewMagazine()
+	{
+		Magazine* magazine = new Magazine;
+		magazine->count = 0;
+		return magazine;
+	}
+
+	// free the magazine's blocks to the pool, then keep it as an empty magazine
+	void ReturnMagazine(Magazine* magazine)
+	{
+		m_pool.FreeBatch(magazine->rounds, magazine->count);
+		magazine->count = 0;
+		PushEmpty(magazine);
+	}
+
+	Magazine* PopFull()
+	{
+		return reinterpret_cast<Magazine*>(m_full.Pop());
+	}
+
+	// pops an empty magazine, making a new one if the depot has none (unless make is false)
+	Magazine* PopEmpty(bool make = true)
+	{
+		Magazine* magazine = reinterpret_cast<Magazine*>(m_empty.Pop());
+		if (magazine == nullptr && make)
+			magazine = NewMagazine();
+		return magazine;
+	}
+
+	void PushFull(Magazine* magazine)
+	{
+		m_full.Push(&magazine->node);
+	}
+
+	void PushEmpty(Magazine* magazine)
+	{
+		m_empty.Push(&magazine->node);
+	}
+
+	PoolAllocator<T, LockFree> m_pool;	// blocks behind the magazines
+	LockFree::FreeList m_full;			// depot of full magazines
+	LockFree::FreeList m_empty;			// depot of empty magazines
+};
@@ -2,159 +2,831 @@
 #pragma once
 
 #include <cstdlib>
-#define ASSERT(condition) if((cond)) {} else { __debugbreak(); }
+#include <cstdint>
+#include <atomic>
+#include <new>
+#include "AllocatorDebug.h"
+#include "VirtualArena.h"
+
+// node of a free list, written into each free block
+// the link is atomic: a lock free pop can read it while another thread pushes the node again.
+// the accessors are relaxed, so they cost the same as plain loads and stores
+struct FreeNode
+{
+	FreeNode* Next() const
+	{
+		return m_next.load(std::memory_order_relaxed);
+	}
+
+	void SetNext(FreeNode* next)
+	{
+		m_next.store(next, std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<FreeNode*> m_next;	// next node in the list
+};
+
+static_assert(sizeof(FreeNode) == sizeof(void*), "FreeNode must fit in a pointer sized block!");
+
+// thread policy for pools only used by one thread at a time (the default)
+// plain free list and counters, no synchronization at all
+struct SingleThreaded
+{
+	typedef unsigned Counter;
+
+	// returns the counter, then adds amount
+	static unsigned FetchAdd(Counter& counter, unsigned amount)
+	{
+		unsigned value = counter;
+		counter += amount;
+		return value;
+	}
+
+	// singly linked list of free blocks
+	class FreeList
+	{
+	public:
+		FreeList() : m_head(nullptr) {}
+
+		// pop front, nullptr if empty
+		FreeNode* Pop()
+		{
+			FreeNode* node = m_head;
+			if (node)
+				m_head = node->Next();
+			return node;
+		}
+
+		// pop up to count nodes off the front into out as one segment, returns how many were popped
+		template<typename P>
+		unsigned PopChain(P** out, unsigned count)
+		{
+			FreeNode* node = m_head;
+			unsigned popped = 0;
+			while (node && popped < count)
+			{
+				out[popped++] = reinterpret_cast<P*>(node);
+				node = node->Next();
+			}
+			m_head = node;
+			return popped;
+		}
+
+		// push front
+		void Push(FreeNode* node)
+		{
+			node->SetNext(m_head);
+			m_head = node;
+		}
+
+		// push front a chain of nodes already linked from first to last
+		void PushChain(FreeNode* first, FreeNode* last)
+		{
+			last->SetNext(m_head);
+			m_head = first;
+		}
+
+		void Clear()
+		{
+			m_head = nullptr;
+		}
+
+		// nobody owns a shared list, nothing to do
+		void Disown() {}
+
+	private:
+		FreeNode* m_head;	// front of the free list
+	};
+};
+
+// thread policy for pools shared between threads, without locks
+// the free list is a Treiber stack: push and pop are one compare and swap on the head.
+// the head packs a tag with the pointer, bumped on every change, so a pop can't succeed
+// when the head was popped and pushed back in between (the ABA problem).
+// counters are atomic but relaxed, they're only statistics.
+// Clear and destruction still need the pool to be idle.
+struct LockFree
+{
+	// atomic counter with the same interface as unsigned
+	class Counter
+	{
+	public:
+		Counter(unsigned value = 0) : m_value(value) {}
+		Counter& operator=(unsigned value) { m_value.store(value, std::memory_order_relaxed); return *this; }
+		Counter& operator++() { m_value.fetch_add(1, std::memory_order_relaxed); return *this; }
+		Counter& operator--() { m_value.fetch_sub(1, std::memory_order_relaxed); return *this; }
+		Counter& operator+=(unsigned amount) { m_value.fetch_add(amount, std::memory_order_relaxed); return *this; }
+		Counter& operator-=(unsigned amount) { m_value.fetch_sub(amount, std::memory_order_relaxed); return *this; }
+		operator unsigned() const { return m_value.load(std::memory_order_relaxed); }
+
+		// returns the counter, then adds amount, in one atomic step
+		unsigned FetchAdd(unsigned amount) { return m_value.fetch_add(amount, std::memory_order_relaxed); }
+
+	private:
+		std::atomic<unsigned> m_value;
+	};
+
+	static unsigned FetchAdd(Counter& counter, unsigned amount)
+	{
+		return counter.FetchAdd(amount);
+	}
+
+	// Treiber stack of free blocks with a tagged head
+	class FreeList
+	{
+		static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "LockFree needs lock free 64 bit atomics!");
+
+		// user space pointers fit in 48 bits on 64 bit targets, the tag gets the rest
+		static const unsigned POINTER_BITS = sizeof(void*) == 8 ? 48 : 32;
+		static const uint64_t POINTER_MASK = (uint64_t(1) << POINTER_BITS) - 1;
+
+	public:
+		FreeList() : m_head(0) {}
+
+		// pop front, nullptr if empty
+		FreeNode* Pop()
+		{
+			uint64_t head = m_head.load(std::memory_order_acquire);
+			for (;;)
+			{
+				FreeNode* node = Pointer(head);
+				if (node == nullptr)
+					return nullptr;
+
+				// node may already be popped by another thread, making next garbage,
+				// but then the tag changed and the exchange fails.
+				// pool memory is never unmapped while the pool is in use, and the link is
+				// read atomically, so the read is safe even while it's being pushed again.
+				uint64_t next = Pack(node->Next(), Tag(head) + 1);
+				if (m_head.compare_exchange_weak(head, next, std::memory_order_acquire, std::memory_order_acquire))
+					return node;
+			}
+		}
+
+		// pop up to count nodes into out, returns how many were popped
+		// they're popped one at a time: unlinking a longer segment would mean walking next pointers
+		// of nodes other threads may have popped and written over in the meantime
+		template<typename P>
+		unsigned PopChain(P** out, unsigned count)
+		{
+			unsigned popped = 0;
+			while (popped < count)
+			{
+				FreeNode* node = Pop();
+				if (node == nullptr)
+					break;
+				out[popped++] = reinterpret_cast<P*>(node);
+			}
+			return popped;
+		}
+
+		// push front
+		void Push(FreeNode* node)
+		{
+			PushChain(node, node);
+		}
+
+		// push front a chain of nodes already linked from first to last
+		void PushChain(FreeNode* first, FreeNode* last)
+		{
+			ASSERT((reinterpret_cast<uintptr_t>(first) & ~POINTER_MASK) == 0 && "pointer doesn't fit in a tagged head!");
+			uint64_t head = m_head.load(std::memory_order_relaxed);
+			do
+			{
+				last->SetNext(Pointer(head));
+			} while (!m_head.compare_exchange_weak(head, Pack(first, Tag(head) + 1), std::memory_order_release, std::memory_order_relaxed));
+		}
+
+		void Clear()
+		{
+			m_head.store(0, std::memory_order_relaxed);
+		}
+
+		// nobody owns a shared list, nothing to do
+		void Disown() {}
+
+	private:
+		static uint64_t Pack(FreeNode* node, uint64_t tag)
+		{
+			return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(node)) | (tag << POINTER_BITS);
+		}
+
+		static FreeNode* Pointer(uint64_t head)
+		{
+			return reinterpret_cast<FreeNode*>(static_cast<uintptr_t>(head & POINTER_MASK));
+		}
+
+		static uint64_t Tag(uint64_t head)
+		{
+			return head >> POINTER_BITS;
+		}
+
+		std::atomic<uint64_t> m_head;	// tag and pointer to the front of the free list
+	};
+};
+
+// thread policy for pools that one thread allocates from, but any thread can free to
+// the owner's free list is plain, with no synchronization. other threads push the blocks they free
+// onto an atomic inbox without a lock, and the owner takes the whole inbox in one exchange when
+// its own list runs out, so foreign frees cost the owner one atomic per batch instead of one per block.
+// nothing is ever popped off the inbox one at a time, so there's no ABA problem and no tag.
+// a free list belongs to the first thread that pops from (or pushes to) it after it's made or cleared,
+// for a pool that's the first thread to allocate. Clear and destruction still need the pool to be idle.
+struct ThreadOwned
+{
+	typedef LockFree::Counter Counter;
+
+	static unsigned FetchAdd(Counter& counter, unsigned amount)
+	{
+		return counter.FetchAdd(amount);
+	}
+
+	// owner's free list plus an inbox of blocks freed by other threads
+	class FreeList
+	{
+	public:
+		FreeList() : m_head(nullptr), m_owner(nullptr), m_inbox(nullptr) {}
+
+		// pop front, taking the inbox when the owner's list is empty, nullptr if both are
+		// only the owner pops
+		FreeNode* Pop()
+		{
+			bool owner = Claim();
+			ASSERT(owner && "only the owning thread may allocate from a ThreadOwned pool");
+			(void)owner;
+			if (m_head == nullptr && !Drain())
+				return nullptr;
+
+			FreeNode* node = m_head;
+			m_head = node->Next();
+			return node;
+		}
+
+		// pop up to count nodes into out, returns how many were popped
+		template<typename P>
+		unsigned PopChain(P** out, unsigned count)
+		{
+			bool owner = Claim();
+			ASSERT(owner && "only the owning thread may allocate from a ThreadOwned pool");
+			(void)owner;
+			unsigned popped = 0;
+			while (popped < count && (m_head || Drain()))
+			{
+				// unlink a segment of the owner's list
+				FreeNode* node = m_head;
+				while (node && popped < count)
+				{
+					out[popped++] = reinterpret_cast<P*>(node);
+					node = node->Next();
+				}
+				m_head = node;
+			}
+			return popped;
+		}
+
+		// push front, onto the owner's list or the inbox depending on the thread
+		void Push(FreeNode* node)
+		{
+			PushChain(node, node);
+		}
+
+		// push front a chain of nodes already linked from first to last
+		void PushChain(FreeNode* first, FreeNode* last)
+		{
+			// case owner, plain push
+			if (Claim())
+			{
+				last->SetNext(m_head);
+				m_head = first;
+				return;
+			}
+
+			// case another thread, push onto the inbox
+			FreeNode* inbox = m_inbox.load(std::memory_order_relaxed);
+			do
+			{
+				last->SetNext(inbox);
+			} while (!m_inbox.compare_exchange_weak(inbox, first, std::memory_order_release, std::memory_order_relaxed));
+		}
+
+		// empties both lists, the next thread to use the list owns it
+		void Clear()
+		{
+			m_head = nullptr;
+			Disown();
+			m_inbox.store(nullptr, std::memory_order_relaxed);
+		}
+
+		// gives up ownership without emptying the list, the next thread to use it owns it
+		// the list must be idle
+		void Disown()
+		{
+			m_owner.store(nullptr, std::memory_order_relaxed);
+		}
+
+	private:
+		// address unique to the calling thread
+		static const void* ThreadToken()
+		{
+			static thread_local char s_token;
+			return &s_token;
+		}
+
+		// whether the calling thread owns the list, claiming it if nobody does yet
+		bool Claim()
+		{
+			const void* token = ThreadToken();
+			const void* owner = m_owner.load(std::memory_order_relaxed);
+			if (owner == nullptr && m_owner.compare_exchange_strong(owner, token, std::memory_order_relaxed))
+				return true;
+			return owner == token;
+		}
+
+		// moves the whole inbox onto the owner's (empty) list, false if the inbox was empty
+		bool Drain()
+		{
+			m_head = m_inbox.exchange(nullptr, std::memory_order_acquire);
+			return m_head != nullptr;
+		}
+
+		FreeNode* m_head;					// front of the owner's free list
+		std::atomic<const void*> m_owner;	// token of the owning thread, nullptr until claimed
+		std::atomic<FreeNode*> m_inbox;		// front of the blocks freed by other threads
+	};
+};
+
+// what a pool does when it runs out of blocks
+enum PoolOverflow
+{
+	poFixed,		// nothing, running out is an error
+	poMalloc,		// malloc each extra object (scattered in the heap, must all be freed before the pool is destroyed)
+	poPaged			// chain another page of blocks onto the free list
+};
+
+// what Clear does with the extra pages of a paged pool
+enum PoolClear
+{
+	pcReleasePages,	// free them, the pool goes back to its first maxObjects blocks
+	pcRetainPages	// keep them, the pool stays at its largest size
+};
+
+// size of a cache line, align pool blocks to it to keep objects from sharing lines between threads
+static const unsigned CACHE_LINE_SIZE = 64;
+
+// default size of the extra pages of a paged pool
+static const unsigned POOL_PAGE_BYTES = 64 * 1024;
+
+// allocate memory aligned to alignment (a power of 2), free it with AlignedFree
+inline void* AlignedMalloc(size_t bytes, size_t alignment)
+{
+#ifdef _MSC_VER
+	return _aligned_malloc(bytes, alignment);
+#else
+	// aligned_alloc wants the size to be a multiple of the alignment
+	return std::aligned_alloc(alignment, (bytes + alignment - 1) & ~(alignment - 1));
+#endif
+}
+
+inline void AlignedFree(void* memory)
+{
+#ifdef _MSC_VER
+	_aligned_free(memory);
+#else
+	std::free(memory);
+#endif
+}
 
 // internal pool allocator used by PoolAllocator<T>
 // DON'T USE THIS UNLESS YOU REALLY NEED IT
-// pool allocator, no paging, one block at a time
-template<unsigned B>
+// pool allocator, one block at a time.
+// blocks that were never used are handed out by bumping an index, the free list only holds
+// blocks that were freed. so making and clearing a pool is O(1), and doesn't touch its memory.
+// when the first maxObjects blocks run out, it can malloc each extra object, or grow by pages:
+// pages are aligned to their size, so any block finds its page's header by masking its address
+// ThreadPolicy is SingleThreaded (no synchronization), LockFree (Alloc and Free from any thread)
+// or ThreadOwned (Alloc from one thread, Free from any)
+// every block is aligned to A (a power of 2), blocks are B rounded up to a multiple of A apart
+template<unsigned B, typename ThreadPolicy = SingleThreaded, unsigned A = alignof(FreeNode)>
 class PoolAllocatorImpl
 {
-	struct PoolObject
+	typedef typename ThreadPolicy::FreeList FreeList;
+	typedef typename ThreadPolicy::Counter Counter;
+
+	static_assert(A >= alignof(FreeNode) && (A & (A - 1)) == 0, "PoolAllocatorImpl is created with alignment A not a power of 2, or too small!");
+	static const unsigned STRIDE = (B + A - 1) & ~(A - 1);
+
+	// header at the start of each extra page
+	struct PoolPage
 	{
-		PoolObject* next;
+		FreeNode link;			// link in the list of pages, must be first
+		const void* owner;		// pool the page belongs to
 	};
+
+	// offset of the first block in a page, after the header
+	static const unsigned PAGE_HEADER = (sizeof(PoolPage) + A - 1) & ~(A - 1);
 public:
 	PoolAllocatorImpl(unsigned maxObjects, bool allowExtraAllocations = true)
+		: PoolAllocatorImpl(maxObjects, allowExtraAllocations ? poMalloc : poFixed) {}
+
+	// pageBytes must be a power of 2, only used by poPaged
+	PoolAllocatorImpl(unsigned maxObjects, PoolOverflow overflow, PoolClear clear = pcReleasePages, unsigned pageBytes = POOL_PAGE_BYTES)
 	{
-		static_assert(B >= sizeof(void*), "PoolAllocatorImpl is created with size B too small!");
-		m_sizePerObject = B;
-		m_maxObjects = maxObjects;
-		m_poolSize = m_maxObjects * m_sizePerObject;
-		m_numObjects = 0; 
-		m_allowExtraAllocations = allowExtraAllocations;
-		m_numExtraAllocations = 0; 
-		m_freeList = nullptr;
+		Init(maxObjects, overflow, clear, pageBytes, nullptr);
+	}
 
-		CreatePool();
+	// pool on an OS backed arena instead of malloc (extra pages still come from the heap)
+	PoolAllocatorImpl(unsigned maxObjects, const ArenaOptions& arena, PoolOverflow overflow = poFixed,
+		PoolClear clear = pcReleasePages, unsigned pageBytes = POOL_PAGE_BYTES)
+	{
+		Init(maxObjects, overflow, clear, pageBytes, &arena);
 	}
 
 	~PoolAllocatorImpl()
 	{
 		// ensure that there aren't un-free extra allocations (memory leaks)
+		ALLOCATOR_STAT(m_stats.ReportLeaks(stderr));
 		ASSERT(m_numExtraAllocations == 0);
-		if (m_pool)
+		if (m_arena)
+		{
+			delete m_arena;
+			m_arena = nullptr;
+		}
+		else if (m_pool)
 		{
-			free(m_pool);
-			m_pool = nullptr;
+			AlignedFree(m_pool);
 		}
+		m_pool = nullptr;
 
-		m_freeList = nullptr;
+		// free extra pages, the destructing thread may not be the one that added them
+		m_pages.Disown();
+		while (FreeNode* page = m_pages.Pop())
+			AlignedFree(page);
+
+		m_freeList.Clear();
 	}
 
 	// raw allocate one block of bytes
-	void* Alloc()
+	// tag is the callsite (ALLOC_TAG), only kept when ALLOCATOR_STATS is on
+	void* Alloc(AllocTag tag = AllocTag())
 	{
 		ASSERT(m_pool);
+		(void)tag;
+
+		void* object = PopBlock();
 
 		// case no more available objects
-		if (m_freeList == nullptr)
+		if (object == nullptr)
 		{
-			// assert no more blocks available
-			ASSERT(m_allowExtraAllocations);
-			++m_numExtraAllocations;
-			++m_numObjects;
+			ALLOCATOR_STAT(m_stats.OnOverflow());
 
-			// allocate on the heap
-			void* object = malloc(m_sizePerObject);
-			return object;
-		}
-		// case objects available
-		else
-		{
-			// pop front of the free linked list
-			PoolObject* object = m_freeList;
-			m_freeList = m_freeList->next;
-			++m_numObjects;
-			return object;
+			// case paged, add a page and take its first block
+			if (m_overflow == poPaged)
+				object = AddPage();
+			else
+			{
+				// assert no more blocks available
+				ASSERT(m_overflow == poMalloc && "pool ran out of blocks!");
+				++m_numExtraAllocations;
+
+				// allocate on the heap
+				object = AlignedMalloc(m_sizePerObject, A);
+			}
 		}
+
+		++m_numObjects;
+		ALLOCATOR_STAT(m_stats.OnAlloc(object, m_sizePerObject, tag));
+		return object;
 	}
 
 	void Free(void* object)
 	{
 		ASSERT(object && m_pool);
-		char* obj = (char*)object;
-		size_t objDistance, poolDistance;
-		objDistance = obj - m_pool;
-		poolDistance = (m_pool + m_poolSize) - m_pool;
+		ALLOCATOR_STAT(m_stats.OnFree(object));
 
-		// case object is not within the pool
-		if (poolDistance < objDistance && objDistance >= 0)
+		// case object was allocated on the heap when the pool ran out
+		if (m_overflow == poMalloc && !InPool(object))
 		{
-			ASSERT(m_allowExtraAllocations);
 			--m_numExtraAllocations;
 
 			// free from heap
-			free(object);
+			AlignedFree(object);
 		}
-		// case object is within the pool
+		// case object is within the pool or one of its pages
 		else
 		{
+			ASSERT(Owns(object) && "freeing an object that isn't from this pool!");
+
 			// push front to singly linked list
-			PoolObject* memObj = (PoolObject*)(object);
-			memObj->next = m_freeList;
-			m_freeList = memObj;
+			m_freeList.Push((FreeNode*)(object));
 		}
 
 		--m_numObjects;
 	}
 
+	// composable interface (AllocatorComposition.h): one block if bytes fit in it, else nullptr.
+	// a poFixed pool that's out of blocks returns nullptr too, instead of asserting,
+	// so a Fallback can pass the request on
+	void* Allocate(size_t bytes)
+	{
+		if (bytes > B)
+			return nullptr;
+		if (m_overflow != poFixed)
+			return Alloc();
+
+		void* object = PopBlock();
+		if (object)
+		{
+			++m_numObjects;
+			ALLOCATOR_STAT(m_stats.OnAlloc(object, m_sizePerObject, AllocTag()));
+		}
+		return object;
+	}
+
+	void Deallocate(void* object, size_t)
+	{
+		Free(object);
+	}
+
+	// raw allocate count blocks into out, the same as count calls to Alloc but cheaper:
+	// freed blocks are unlinked from the free list as one segment (one at a time with LockFree),
+	// never used blocks are taken with one bump of the index, and the counters are updated once
+	template<typename P>
+	void AllocBatch(P** out, unsigned count, AllocTag tag = AllocTag())
+	{
+		ASSERT(m_pool && (out || count == 0));
+		(void)tag;
+
+		// freed blocks first
+		unsigned taken = m_freeList.PopChain(out, count);
+
+		// then never used blocks, reserving all that are still needed at once
+		if (taken < count && m_nextUnused < m_maxObjects)
+		{
+			unsigned index = ThreadPolicy::FetchAdd(m_nextUnused, count - taken);
+			for (; taken < count && index < m_maxObjects; ++index)
+				out[taken++] = reinterpret_cast<P*>(m_pool + static_cast<size_t>(index) * m_sizePerObject);
+		}
+
+		m_numObjects += taken;
+		ALLOCATOR_STAT(for (unsigned i = 0; i < taken; ++i) m_stats.OnAlloc(out[i], m_sizePerObject, tag);)
+
+		// case the pool ran out, the rest overflow one at a time
+		for (; taken < count; ++taken)
+			out[taken] = reinterpret_cast<P*>(Alloc(tag));
+	}
+
+	// free count blocks, the same as count calls to Free but cheaper:
+	// they're linked into one chain and spliced onto the free list at once
+	template<typename P>
+	void FreeBatch(P* const* objects, unsigned count)
+	{
+		ASSERT(m_pool && (objects || count == 0));
+		FreeNode* first = nullptr;
+		FreeNode* last = nullptr;
+
+		for (unsigned i = 0; i < count; ++i)
+		{
+			void* object = const_cast<void*>(static_cast<const void*>(objects[i]));
+			ASSERT(object);
+			ALLOCATOR_STAT(m_stats.OnFree(object));
+
+			// case object was allocated on the heap when the pool ran out
+			if (m_overflow == poMalloc && !InPool(object))
+			{
+				--m_numExtraAllocations;
+				AlignedFree(object);
+			}
+			// case object is within the pool or one of its pages, link it into the chain
+			else
+			{
+				ASSERT(Owns(object) && "freeing an object that isn't from this pool!");
+				FreeNode* node = (FreeNode*)(object);
+				node->SetNext(first);
+				first = node;
+				if (last == nullptr)
+					last = node;
+			}
+		}
+
+		if (first)
+			m_freeList.PushChain(first, last);
+		m_numObjects -= count;
+	}
+
 	void Clear()
 	{
-		// free entire pool
+		// every block is free again
 		ASSERT(m_numExtraAllocations == 0);
-		free(m_pool);
-		m_freeList = nullptr;
+		m_freeList.Clear();
+		m_numObjects = 0;
+		ALLOCATOR_STAT(m_stats.OnClear());
+
+		// release or rethread the extra pages
+		// the clearing thread owns the lists while it does, that's undone below
+		m_pages.Disown();
+		SingleThreaded::FreeList retained;
+		while (FreeNode* page = m_pages.Pop())
+		{
+			if (m_clear == pcReleasePages)
+			{
+				AlignedFree(page);
+				--m_numPages;
+			}
+			else
+			{
+				ThreadBlocks(reinterpret_cast<char*>(page) + PAGE_HEADER, m_objectsPerPage);
+				retained.Push(page);
+			}
+		}
+		while (FreeNode* page = retained.Pop())
+			m_pages.Push(page);
 
-		// recreate entire pool
-		CreatePool();
+		// the next thread to allocate owns the pool, not the one that cleared it
+		m_freeList.Disown();
+		m_pages.Disown();
+
+		// give the pool's pages back to the OS, they're faulted in again as they're used
+		if (m_releaseOnClear)
+			m_arena->ReleaseAll();
+
+		// every block of the pool is unused again
+		m_nextUnused = 0;
+	}
+
+	// whether object is one of this pool's blocks (heap objects from poMalloc aren't)
+	// for a paged pool, object must be a block from some pool, since its page header is read
+	bool Owns(const void* object) const
+	{
+		if (InPool(object))
+			return true;
+		if (m_overflow != poPaged)
+			return false;
+
+		// mask down to the start of the page
+		uintptr_t page = reinterpret_cast<uintptr_t>(object) & ~static_cast<uintptr_t>(m_pageBytes - 1);
+		return reinterpret_cast<const PoolPage*>(page)->owner == this;
 	}
 
+	// number of extra pages a paged pool has grown by
+	unsigned NumPages() const
+	{
+		return m_numPages;
+	}
+
+	// current number of objects allocated
+	unsigned NumObjects() const
+	{
+		return m_numObjects;
+	}
+
+#if ALLOCATOR_STATS
+	const AllocatorStats& Stats() const
+	{
+		return m_stats;
+	}
+#endif
+
 private:
 
-	void CreatePool()
+	void Init(unsigned maxObjects, PoolOverflow overflow, PoolClear clear, unsigned pageBytes, const ArenaOptions* arena)
+	{
+		static_assert(B >= sizeof(void*), "PoolAllocatorImpl is created with size B too small!");
+		m_sizePerObject = STRIDE;
+		m_maxObjects = maxObjects;
+		m_poolSize = m_maxObjects * m_sizePerObject;
+		m_numObjects = 0; 
+		m_overflow = overflow;
+		m_clear = clear;
+		m_numExtraAllocations = 0; 
+		m_pageBytes = pageBytes;
+		m_objectsPerPage = (pageBytes - PAGE_HEADER) / m_sizePerObject;
+		m_numPages = 0;
+		ASSERT((overflow != poPaged || ((pageBytes & (pageBytes - 1)) == 0 && pageBytes >= PAGE_HEADER + STRIDE)) &&
+			"pages must be a power of 2 bytes, big enough for a block!");
+
+		m_arena = nullptr;
+		m_releaseOnClear = arena && arena->releaseOnClear;
+
+		CreatePool(arena);
+	}
+
+	void CreatePool(const ArenaOptions* arena)
 	{
-		m_pool = (char*)malloc(m_poolSize);
+		if (arena)
+		{
+			m_arena = new VirtualArena(m_poolSize, *arena);
+			m_pool = m_arena->Base();
+		}
+		else
+			m_pool = (char*)AlignedMalloc(m_poolSize ? m_poolSize : A, A);
 		ASSERT(m_pool && "allocating space for memory pool failed!");
 
-		// init the free list
-		for (unsigned i = 0; i < m_maxObjects; ++i)
+		// no blocks used yet, the free list starts empty
+		m_nextUnused = 0;
+	}
+
+	// pops a freed block, or else takes the next block that was never used, nullptr if there's neither
+	void* PopBlock()
+	{
+		// pop front of the free linked list
+		void* object = m_freeList.Pop();
+
+		// case no freed blocks, take the next block that was never used
+		// (with LockFree, threads racing past the end overshoot the index a little, that's harmless)
+		if (object == nullptr && m_nextUnused < m_maxObjects)
 		{
-			PoolObject* obj = (PoolObject*)(m_pool + i * m_sizePerObject);
-			obj->next = m_freeList;
-			m_freeList = obj;
+			unsigned index = ThreadPolicy::FetchAdd(m_nextUnused, 1);
+			if (index < m_maxObjects)
+				object = m_pool + static_cast<size_t>(index) * m_sizePerObject;
 		}
+		return object;
 	}
 
-	unsigned m_sizePerObject;			// bytes per object (same as B)
-	unsigned m_maxObjects;				// max number of objects in the pool (pool isn't dynamic resizing)
-	unsigned m_numObjects;				// current number of objects in the pool
+	// links count blocks starting at blocks as one chain and pushes it onto the free list
+	void ThreadBlocks(char* blocks, unsigned count)
+	{
+		if (count == 0)
+			return;
+		FreeNode* last = (FreeNode*)(blocks);
+		FreeNode* first = last;
+		for (unsigned i = 1; i < count; ++i)
+		{
+			FreeNode* obj = (FreeNode*)(blocks + i * m_sizePerObject);
+			obj->SetNext(first);
+			first = obj;
+		}
+		m_freeList.PushChain(first, last);
+	}
+
+	// allocates a page, puts all but its first block on the free list, and returns the first block
+	void* AddPage()
+	{
+		PoolPage* page = (PoolPage*)AlignedMalloc(m_pageBytes, m_pageBytes);
+		ASSERT(page && "allocating a page for memory pool failed!");
+		page->owner = this;
+		m_pages.Push(&page->link);
+		++m_numPages;
+
+		char* blocks = reinterpret_cast<char*>(page) + PAGE_HEADER;
+		ThreadBlocks(blocks + m_sizePerObject, m_objectsPerPage - 1);
+		return blocks;
+	}
+
+	// whether object is in the first maxObjects blocks (one unsigned compare covers both ends)
+	bool InPool(const void* object) const
+	{
+		return reinterpret_cast<uintptr_t>(object) - reinterpret_cast<uintptr_t>(m_pool) < m_poolSize;
+	}
+
+	unsigned m_sizePerObject;			// bytes per object (B rounded up to the alignment)
+	unsigned m_maxObjects;				// number of objects in the pool, before any extra pages
+	Counter m_numObjects;				// current number of objects in the pool
 	unsigned m_poolSize;				// size of the pool in bytes
-	unsigned m_numExtraAllocations;		// count of extra allocations outside of the pool
+	Counter m_numExtraAllocations;		// count of extra allocations outside of the pool
 	char* m_pool;						// pool of bytes
-	PoolObject* m_freeList;				// singly linked list of free objects
-	bool m_allowExtraAllocations;		// whether to allow allocations outside of pool in case max objects isn't enough
+	FreeList m_freeList;				// singly linked list of freed objects
+	Counter m_nextUnused;				// index of the first block in the pool that was never used
+	PoolOverflow m_overflow;			// what to do in case max objects isn't enough
+	PoolClear m_clear;					// what Clear does with extra pages
+	unsigned m_pageBytes;				// size and alignment of each extra page
+	unsigned m_objectsPerPage;			// number of objects in each extra page
+	FreeList m_pages;					// list of extra pages
+	VirtualArena* m_arena;				// OS backed memory of the pool, nullptr if it's from malloc
+	bool m_releaseOnClear;				// whether Clear gives the arena's pages back to the OS
+	Counter m_numPages;					// number of extra pages
+	ALLOCATOR_STAT(AllocatorStats m_stats{ "PoolAllocator" };)	// instrumentation, if compiled in
 };
 
 // templated pool allocator
-// it can handle extra allocations beyond the max objects, but won't clean up
-// that memory for you.
+// it can handle extra allocations beyond the max objects, either by malloc (but won't clean up
+// that memory for you), or by growing in pages that stay part of the pool.
 // sizeof(T) must be >= sizeof(void*) or won't compile
 // Alloc doesn't call T's constructor,
 // Construct does
 // Free doesn't call T's destructor
 // Destruct does
 // Clear doesn't call destructors
-template<typename T>
+// PoolAllocator<T, LockFree> can Alloc and Free from any number of threads
+// PoolAllocator<T, ThreadOwned> can Alloc from one thread and Free from any, for objects handed between threads
+// objects are aligned to alignof(T), or A if given (e.g. CACHE_LINE_SIZE to give each object its own cache line)
+template<typename T, typename ThreadPolicy = SingleThreaded, unsigned A = alignof(T)>
 class PoolAllocator
 {
 public:
-	PoolAllocator(u32 maxObjects, bool allowExtraAllocations = true)
+	PoolAllocator(unsigned maxObjects, bool allowExtraAllocations = true)
 		: m_allocator(maxObjects, allowExtraAllocations) {}
 
-	T* Alloc()
+	PoolAllocator(unsigned maxObjects, PoolOverflow overflow, PoolClear clear = pcReleasePages, unsigned pageBytes = POOL_PAGE_BYTES)
+		: m_allocator(maxObjects, overflow, clear, pageBytes) {}
+
+	PoolAllocator(unsigned maxObjects, const ArenaOptions& arena, PoolOverflow overflow = poFixed,
+		PoolClear clear = pcReleasePages, unsigned pageBytes = POOL_PAGE_BYTES)
+		: m_allocator(maxObjects, arena, overflow, clear, pageBytes) {}
+
+	T* Alloc(AllocTag tag = AllocTag())
 	{
-		return reinterpret_cast<T *>(m_allocator.Alloc());
+		return reinterpret_cast<T *>(m_allocator.Alloc(tag));
 	}
 
 	template<typename... Args>
@@ -167,11 +839,40 @@ public:
 		return obj;
 	}
 
+	// allocate count objects into out, without constructing them
+	void AllocBatch(T** out, unsigned count, AllocTag tag = AllocTag())
+	{
+		m_allocator.AllocBatch(out, count, tag);
+	}
+
+	// allocate count objects into out, each constructed with args
+	template<typename... Args>
+	void ConstructBatch(T** out, unsigned count, Args... args)
+	{
+		AllocBatch(out, count);
+		for (unsigned i = 0; i < count; ++i)
+			new (out[i]) T(args...);
+	}
+
 	void Free(T* address)
 	{
 		m_allocator.Free(address);
 	}
 
+	// free count objects, without destructing them
+	void FreeBatch(T* const* objects, unsigned count)
+	{
+		m_allocator.FreeBatch(objects, count);
+	}
+
+	// destruct count objects, then free them
+	void DestructBatch(T* const* objects, unsigned count)
+	{
+		for (unsigned i = 0; i < count; ++i)
+			objects[i]->~T();
+		FreeBatch(objects, count);
+	}
+
 	void Destruct(T* address)
 	{
 		// destruct then free
@@ -184,6 +885,28 @@ public:
 		m_allocator.Clear();
 	}
 
+	bool Owns(const T* address) const
+	{
+		return m_allocator.Owns(address);
+	}
+
+	unsigned NumPages() const
+	{
+		return m_allocator.NumPages();
+	}
+
+	unsigned NumObjects() const
+	{
+		return m_allocator.NumObjects();
+	}
+
+#if ALLOCATOR_STATS
+	const AllocatorStats& Stats() const
+	{
+		return m_allocator.Stats();
+	}
+#endif
+
 private:
-	PoolAllocatorImpl<sizeof(T)> m_allocator;	// internal version, deals with the bytes itself
+	PoolAllocatorImpl<sizeof(T), ThreadPolicy, (A > alignof(FreeNode) ? A : alignof(FreeNode))> m_allocator;	// internal version, deals with the bytes itself
 };
@@ -0,0 +1,244 @@
+//Matthew Rosen
+#pragma once
+
+#include "PoolAllocator.h"
+
+#include <new>
+#include <tuple>
+#include <utility>
+
+// statistics of one size class (or of oversize requests), only kept when ALLOCATOR_STATS is on
+template<typename ThreadPolicy>
+struct SizeClassStats
+{
+	typename ThreadPolicy::Counter allocs{};	// number of allocations
+	typename ThreadPolicy::Counter frees{};		// number of frees
+
+	// allocations not freed yet
+	unsigned Live() const
+	{
+		return allocs - frees;
+	}
+};
+
+// general small object allocator: one paged pool per size class, picked by size
+// Sizes are the block sizes of the classes, ascending multiples of 8.
+// a request goes to the smallest class that fits, found in a table built at compile time,
+// requests bigger than the last class go to the system allocator.
+// Free takes the size too (like sized delete), so blocks need no header.
+// ThreadPolicy is SingleThreaded, LockFree or ThreadOwned, as for PoolAllocatorImpl.
+template<typename ThreadPolicy, unsigned... Sizes>
+class SizeClassAllocatorImpl
+{
+	static const unsigned NUM_CLASSES = sizeof...(Sizes);
+	static constexpr unsigned SIZES[NUM_CLASSES] = { Sizes... };
+
+public:
+	static constexpr unsigned MAX_SIZE = SIZES[NUM_CLASSES - 1];
+
+private:
+	// blocks that are a multiple of 16 are aligned like malloc, the rest to 8
+	static constexpr unsigned ClassAlignment(unsigned size)
+	{
+		return size % 16 == 0 ? 16 : 8;
+	}
+
+	// pool of one size class, grows by pages from bytes worth of blocks
+	template<unsigned S>
+	class ClassPool : public PoolAllocatorImpl<S, ThreadPolicy, ClassAlignment(S)>
+	{
+	public:
+		explicit ClassPool(unsigned bytes)
+			: PoolAllocatorImpl<S, ThreadPolicy, ClassAlignment(S)>(bytes / S, poPaged) {}
+	};
+
+	// table from (size + 7) / 8 to the index of the smallest class that fits
+	struct ClassTable
+	{
+		unsigned char index[MAX_SIZE / 8 + 1];
+	};
+
+	static constexpr ClassTable MakeClassTable()
+	{
+		ClassTable table = {};
+		unsigned c = 0;
+		for (unsigned i = 0; i <= MAX_SIZE / 8; ++i)
+		{
+			while (SIZES[c] < i * 8)
+				++c;
+			table.index[i] = static_cast<unsigned char>(c);
+		}
+		return table;
+	}
+
+	static constexpr bool SizesAreValid()
+	{
+		for (unsigned i = 0; i < NUM_CLASSES; ++i)
+		{
+			if (SIZES[i] % 8 != 0 || (i > 0 && SIZES[i] <= SIZES[i - 1]))
+				return false;
+		}
+		return true;
+	}
+
+	static_assert(NUM_CLASSES > 0 && NUM_CLASSES < 256, "SizeClassAllocatorImpl needs 1 to 255 size classes!");
+	static_assert(SizesAreValid(), "SizeClassAllocatorImpl sizes must be ascending multiples of 8!");
+
+	static constexpr ClassTable CLASS_TABLE = MakeClassTable();
+
+	typedef std::tuple<ClassPool<Sizes>...> Pools;
+	typedef void* (*AllocFn)(Pools&);
+	typedef void (*FreeFn)(Pools&, void*);
+
+	template<size_t I>
+	static void* AllocFrom(Pools& pools)
+	{
+		return std::get<I>(pools).Alloc();
+	}
+
+	template<size_t I>
+	static void FreeTo(Pools& pools, void* object)
+	{
+		std::get<I>(pools).Free(object);
+	}
+
+public:
+	// each class starts with bytesPerClass worth of blocks, then grows in pages
+	explicit SizeClassAllocatorImpl(unsigned bytesPerClass = POOL_PAGE_BYTES)
+		: m_pools(((void)Sizes, bytesPerClass)...)	// bytesPerClass for each class
+	{
+		InitDispatch(std::make_index_sequence<NUM_CLASSES>());
+	}
+
+	SizeClassAllocatorImpl(const SizeClassAllocatorImpl&) = delete;
+	SizeClassAllocatorImpl& operator=(const SizeClassAllocatorImpl&) = delete;
+
+	// index of the class serving size bytes, NUM_CLASSES if it's oversize
+	static constexpr unsigned ClassOf(size_t size)
+	{
+		return size <= MAX_SIZE ? CLASS_TABLE.index[(size + 7) >> 3] : NUM_CLASSES;
+	}
+
+	static constexpr unsigned NumClasses()
+	{
+		return NUM_CLASSES;
+	}
+
+	// block size of class c (0 for the oversize class)
+	static constexpr unsigned ClassSize(unsigned c)
+	{
+		return c < NUM_CLASSES ? SIZES[c] : 0;
+	}
+
+	void* Alloc(size_t size)
+	{
+		unsigned c = ClassOf(size);
+		ALLOCATOR_STAT(++m_stats[c].allocs);
+
+		// case oversize, go to the system
+		if (c == NUM_CLASSES)
+			return ::operator new(size);
+
+		return m_alloc[c](m_pools);
+	}
+
+	// size must be the size passed to Alloc
+	void Free(void* object, size_t size)
+	{
+		if (object == nullptr)
+			return;
+
+		unsigned c = ClassOf(size);
+		ALLOCATOR_STAT(++m_stats[c].frees);
+
+		// case oversize, give back to the system
+		if (c == NUM_CLASSES)
+			::operator delete(object);
+		else
+			m_free[c](m_pools, object);
+	}
+
+	template<typename T, typename... Args>
+	T* Construct(Args... args)
+	{
+		// pass args to placement new
+		return new (Alloc(sizeof(T))) T(args...);
+	}
+
+	template<typename T>
+	void Destruct(T* address)
+	{
+		// destruct then free
+		address->~T();
+		Free(address, sizeof(T));
+	}
+
+#if ALLOCATOR_STATS
+	// statistics of class c, NUM_CLASSES for oversize requests
+	const SizeClassStats<ThreadPolicy>& Stats(unsigned c) const
+	{
+		return m_stats[c];
+	}
+#endif
+
+private:
+	template<size_t... I>
+	void InitDispatch(std::index_sequence<I...>)
+	{
+		AllocFn allocs[] = { &AllocFrom<I>... };
+		FreeFn frees[] = { &FreeTo<I>... };
+		for (unsigned c = 0; c < NUM_CLASSES; ++c)
+		{
+			m_alloc[c] = allocs[c];
+			m_free[c] = frees[c];
+		}
+	}
+
+	Pools m_pools;									// one pool per size class
+	AllocFn m_alloc[NUM_CLASSES];					// Alloc of each class's pool
+	FreeFn m_free[NUM_CLASSES];						// Free of each class's pool
+	ALLOCATOR_STAT(SizeClassStats<ThreadPolicy> m_stats[NUM_CLASSES + 1];)	// statistics per class, then oversize, if compiled in
+};
+
+// default size classes, 8 to 1024 bytes in steps of about 1.5x
+template<typename ThreadPolicy = SingleThreaded>
+using SizeClassAllocator = SizeClassAllocatorImpl<ThreadPolicy, 8, 16, 24, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024>;
+
+// shared thread safe small object allocator, made on first use and never destroyed
+// (so objects can still be deleted during static destruction)
+inline SizeClassAllocator<LockFree>& SmallObjectAllocator()
+{
+	static SizeClassAllocator<LockFree>* allocator = new SizeClassAllocator<LockFree>();
+	return *allocator;
+}
+
+// inherit from SmallObject to make new and delete of a class (and its derived classes)
+// use the small object allocator instead of the heap.
+// sized delete gets the size of the object's real type, as long as the destructor is virtual
+// when deleting through a base pointer.
+// classes aligned past __STDCPP_DEFAULT_NEW_ALIGNMENT__ (e.g. alignas(32) or alignas(64)) go to the
+// aligned system new, since size classes are only aligned to 8 or 16. anything aligned to 16 has a
+// size that's a multiple of 16, so its class is aligned to 16 as well.
+class SmallObject
+{
+public:
+	static void* operator new(size_t size)
+	{
+		return SmallObjectAllocator().Alloc(size);
+	}
+
+	static void* operator new(size_t size, std::align_val_t alignment)
+	{
+		return ::operator new(size, alignment);
+	}
+
+	static void operator delete(void* object, size_t size)
+	{
+		SmallObjectAllocator().Free(object, size);
+	}
+
+	static void operator delete(void* object, size_t, std::align_val_t alignment)
+	{
+		::operator delete(object, alignment);
+	}
+};
@@ -0,0 +1,193 @@
+//Matthew Rosen
+#pragma once
+
+#include "PoolAllocator.h"
+
+#include <new>
+#include <utility>
+
+// reference to an object in a SlotMap, safe to keep after the object is erased
+// (it just stops resolving). a default handle never resolves.
+struct SlotHandle
+{
+	unsigned index = 0;			// slot in the map
+	unsigned generation = 0;	// generation of the slot when the handle was made
+};
+
+inline bool operator==(const SlotHandle& lhs, const SlotHandle& rhs)
+{
+	return lhs.index == rhs.index && lhs.generation == rhs.generation;
+}
+
+inline bool operator!=(const SlotHandle& lhs, const SlotHandle& rhs)
+{
+	return !(lhs == rhs);
+}
+
+// slot map: objects live packed in one block, and are referenced by generational handles
+// * each slot has a generation, bumped when its object is erased, so a handle to an erased
+//   object never resolves again, even after the slot is reused (no ABA)
+// * erase moves the last object into the hole, so the live objects are always contiguous and
+//   iterating walks memory front to back, without any holes
+// * so objects move: Get's pointer is only good until the next erase. keep handles instead.
+//   T must be move constructible.
+// slots are reused like pool blocks: never used ones by bumping an index, freed ones from a free list
+// Usage:
+//	SlotMap<Particle> particles(4096);
+//	SlotHandle h = particles.Insert(position);
+//	if (Particle* p = particles.Get(h)) ...
+//	for (Particle& p : particles) p.Update(dt);
+//	particles.Erase(h);
+template<typename T>
+class SlotMap
+{
+	static const unsigned FREE_END = ~0u;
+
+	// entry of the slot table
+	struct Slot
+	{
+		unsigned generation;	// bumped on each erase, handles must match it
+		unsigned index;			// dense index of the object while live, next free slot while free
+	};
+
+public:
+	explicit SlotMap(unsigned maxObjects)
+		: m_maxObjects(maxObjects), m_size(0), m_nextUnused(0), m_freeSlots(FREE_END)
+	{
+		m_slots = new Slot[maxObjects ? maxObjects : 1];
+		m_dense = (T*)AlignedMalloc(sizeof(T) * (maxObjects ? maxObjects : 1), alignof(T));
+		m_denseSlots = new unsigned[maxObjects ? maxObjects : 1];
+	}
+
+	~SlotMap()
+	{
+		Clear();
+		delete[] m_slots;
+		AlignedFree(m_dense);
+		delete[] m_denseSlots;
+	}
+
+	SlotMap(const SlotMap&) = delete;
+	SlotMap& operator=(const SlotMap&) = delete;
+
+	// construct an object with args, returns its handle
+	template<typename... Args>
+	SlotHandle Insert(Args... args)
+	{
+		ASSERT(m_size < m_maxObjects && "slot map is full!");
+
+		// take a freed slot, or the next never used one
+		unsigned s = m_freeSlots;
+		if (s != FREE_END)
+			m_freeSlots = m_slots[s].index;
+		else
+		{
+			s = m_nextUnused++;
+			m_slots[s].generation = 1;
+		}
+
+		// append to the dense array
+		new (m_dense + m_size) T(args...);
+		m_denseSlots[m_size] = s;
+		m_slots[s].index = m_size++;
+
+		SlotHandle handle;
+		handle.index = s;
+		handle.generation = m_slots[s].generation;
+		return handle;
+	}
+
+	// destruct the object, returns false if the handle didn't resolve
+	bool Erase(SlotHandle handle)
+	{
+		if (!Contains(handle))
+			return false;
+
+		Slot& slot = m_slots[handle.index];
+		unsigned d = slot.index;
+		m_dense[d].~T();
+
+		// move the last object into the hole
+		unsigned last = --m_size;
+		if (d != last)
+		{
+			new (m_dense + d) T(std::move(m_dense[last]));
+			m_dense[last].~T();
+			m_denseSlots[d] = m_denseSlots[last];
+			m_slots[m_denseSlots[d]].index = d;
+		}
+
+		// stale every handle to the slot, then free it
+		++slot.generation;
+		slot.index = m_freeSlots;
+		m_freeSlots = handle.index;
+		return true;
+	}
+
+	// object of the handle, nullptr if it was erased (or the handle is a default one)
+	// the pointer is good until the next Erase, which may move the object
+	T* Get(SlotHandle handle) const
+	{
+		return Contains(handle) ? m_dense + m_slots[handle.index].index : nullptr;
+	}
+
+	bool Contains(SlotHandle handle) const
+	{
+		return handle.index < m_nextUnused && handle.generation == m_slots[handle.index].generation;
+	}
+
+	// handle of the i-th live object in iteration order
+	SlotHandle HandleAt(unsigned i) const
+	{
+		ASSERT(i < m_size);
+		SlotHandle handle;
+		handle.index = m_denseSlots[i];
+		handle.generation = m_slots[handle.index].generation;
+		return handle;
+	}
+
+	// live objects, contiguous (order changes as objects are erased)
+	T* begin() const
+	{
+		return m_dense;
+	}
+
+	T* end() const
+	{
+		return m_dense + m_size;
+	}
+
+	// number of live objects
+	unsigned Size() const
+	{
+		return m_size;
+	}
+
+	unsigned Capacity() const
+	{
+		return m_maxObjects;
+	}
+
+	// destructs every object, stales every handle
+	void Clear()
+	{
+		for (unsigned i = 0; i < m_size; ++i)
+		{
+			Slot& slot = m_slots[m_denseSlots[i]];
+			m_dense[i].~T();
+			++slot.generation;
+			slot.index = m_freeSlots;
+			m_freeSlots = m_denseSlots[i];
+		}
+		m_size = 0;
+	}
+
+private:
+	Slot* m_slots;				// slot table, indexed by handle
+	T* m_dense;					// live objects, packed
+	unsigned* m_denseSlots;		// slot of each live object, for fixing the slot table on swap remove
+	unsigned m_maxObjects;		// capacity
+	unsigned m_size;			// number of live objects
+	unsigned m_nextUnused;		// first slot that was never used
+	unsigned m_freeSlots;		// front of the list of freed slots, FREE_END if empty
+};
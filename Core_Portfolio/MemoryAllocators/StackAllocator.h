@@ -1,20 +1,29 @@
 //Matthew Rosen
 #pragma once
 
+#include <cstddef>
 #include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <type_traits>
 
-#define ASSERT(condition) if((cond)) {} else { __debugbreak(); }
-
+#include "AllocatorDebug.h"
+#include "VirtualArena.h"
 
 // simple stack allocator
-// Alloc<T> allocates an object without constructing it
+// Alloc<T> allocates an object without constructing it, aligned to alignof(T)
 //		it can also allocate an array of objects without construction
+// AllocAligned allocates raw bytes with an explicit alignment (e.g. 32 or 64 for SIMD buffers)
 // Construct<T, Args...> allocates an object (or array of objects) and constructs it (or them)
 // Free<T> frees an object or array of objects without calling its destructor
 // Destruct<T> frees an object after calling its destructor
 //		Free and Destruct can also free an array of objects (Destruct will call dtor on each)
 //		Must pass in number of elements if its an array
 // Clear resets internal ptrs, doesn't destruct any elements
+// GetMarker/FreeToMarker roll the stack back to a saved top in O(1), no matter
+//		how many allocations were made since (StackFrame does it on scope exit)
+// freed bytes are reset to 0 unless the stack is made with zeroOnFree = false
 //
 // Only basic safety checking is done, a lot of trust is placed in the user
 // Usage: 
@@ -22,51 +31,115 @@
 //    they were allocated in
 //	* you can allocate objects of any type, and those objects are guaranteed
 //    to be in contiguous memory
-//	* if your ptr becomes misaligned, freeing it will be catastrophic, and 
-//    there's no way for the stack allocator to know until it crashes
+//	* allocations are moved up by at least 1 byte, to their alignment. the byte right below
+//    the allocation holds how far it was moved, so freeing in reverse order returns
+//    the stack to exactly where it was, and alignment can be at most MAX_ALIGNMENT
 class StackAllocator
 {
 public:
-	StackAllocator(size_t sizeInBytes)
-		: m_stackSize(sizeInBytes)
+	// saved top of the stack, as an offset from the bottom
+	typedef size_t Marker;
+
+	// largest alignment, so the distance an allocation is moved up fits in its header byte
+	static const size_t MAX_ALIGNMENT = 128;
+
+	StackAllocator(size_t sizeInBytes, bool zeroOnFree = true)
+		: m_stackSize(sizeInBytes), m_zeroOnFree(zeroOnFree), m_arena(nullptr), m_releaseOnClear(false)
 	{
-		m_memStack = (char *)malloc(sizeInBytes);
+		// calloc gets big blocks straight from the OS already zeroed, without touching every page
+		m_memStack = (char *)calloc(sizeInBytes ? sizeInBytes : 1, 1);
 		ASSERT(m_memStack);
-		std::memset(m_memStack, 0, sizeInBytes);
+		m_nextPtr = m_memStack;
+	}
+
+	// stack on an OS backed arena instead of malloc
+	StackAllocator(size_t sizeInBytes, const ArenaOptions& arena, bool zeroOnFree = true)
+		: m_stackSize(sizeInBytes), m_zeroOnFree(zeroOnFree), m_releaseOnClear(arena.releaseOnClear)
+	{
+		m_arena = new VirtualArena(sizeInBytes, arena);
+		m_memStack = m_arena->Base();
 		m_nextPtr = m_memStack;
 	}
 
 	~StackAllocator()
 	{
+		ALLOCATOR_STAT(m_stats.ReportLeaks(stderr));
 		ASSERT(m_nextPtr >= m_memStack &&
 			"Some pointer became misaligned before freeing. This is really bad");
 
-		if (m_memStack)
+		if (m_arena)
+		{
+			delete m_arena;
+			m_arena = nullptr;
+		}
+		else if (m_memStack)
 		{
 			free(m_memStack);
-			m_memStack = nullptr;
 		}
+		m_memStack = nullptr;
 
 		m_nextPtr = nullptr;
 		m_stackSize = 0;
 	}
 
 	template<typename T>
-	T* Alloc(unsigned numElements = 1)
+	T* Alloc(unsigned numElements = 1, AllocTag tag = AllocTag())
+	{
+		return reinterpret_cast<T*>(AllocAligned(sizeof(T) * numElements, alignof(T), tag));
+	}
+
+	// allocate bytes aligned to alignment (a power of 2)
+	// tag is the callsite (ALLOC_TAG), only kept when ALLOCATOR_STATS is on
+	void* AllocAligned(size_t bytes, size_t alignment, AllocTag tag = AllocTag())
 	{
+		(void)tag;
+		ASSERT(alignment && (alignment & (alignment - 1)) == 0 && "Alignment must be a power of 2!");
+		ASSERT(alignment <= MAX_ALIGNMENT && "Alignment is too big for the stack's header byte!");
+
+		// round top of stack + 1 up to the alignment, leaving room for the header byte
+		size_t adjustment = Adjustment(m_nextPtr, alignment);
+		char* mem = m_nextPtr + adjustment;
+
 		// ensure that stack can support this allocation
-		ASSERT(m_nextPtr + sizeof(T) * numElements <= m_memStack + m_stackSize &&
-			"Allocation too big, would go outside stack!")
+		ASSERT(adjustment <= (size_t)(m_memStack + m_stackSize - m_nextPtr) &&
+			bytes <= (size_t)(m_memStack + m_stackSize - mem) && "Allocation too big, would go outside stack!");
 
-		// reinterpret top of stack
-		T* mem = reinterpret_cast<T*>(m_nextPtr);
+		// remember how far the allocation was moved up, Free moves back down by as much
+		reinterpret_cast<unsigned char*>(mem)[-1] = static_cast<unsigned char>(adjustment);
 
 		// set top of stack to be where this allocation ends
-		m_nextPtr += sizeof(T) * numElements;
+		m_nextPtr = mem + bytes;
+
+		ALLOCATOR_STAT(m_stats.OnAlloc(mem, bytes, tag));
+		ALLOCATOR_STAT(m_stats.OnUsed(m_nextPtr - m_memStack));
 
 		return mem;
 	}
 
+	// composable interface (AllocatorComposition.h): bytes aligned like malloc,
+	// nullptr if they don't fit instead of asserting, so a Fallback can pass the request on
+	void* Allocate(size_t bytes)
+	{
+		const size_t alignment = alignof(std::max_align_t);
+		size_t start = (m_nextPtr - m_memStack) + Adjustment(m_nextPtr, alignment);
+		if (start > m_stackSize || bytes > m_stackSize - start)
+			return nullptr;
+		return AllocAligned(bytes, alignment);
+	}
+
+	// frees the allocation if it's on top of the stack, otherwise it comes back when the stack is rolled back
+	void Deallocate(void* address, size_t bytes)
+	{
+		if ((char*)address + bytes == m_nextPtr)
+			FreeAligned(address, bytes);
+	}
+
+	// whether address is in the stack's memory
+	bool Owns(const void* address) const
+	{
+		return reinterpret_cast<uintptr_t>(address) - reinterpret_cast<uintptr_t>(m_memStack) < m_stackSize;
+	}
+
 	template<typename T, typename... Args>
 	T* Construct(Args... args)
 	{
@@ -82,14 +155,25 @@ public:
 	template<typename T>
 	void Free(T* address, unsigned numElements = 1)
 	{
-		// assure address is within stack
-		ASSERT(address && (char*)address == m_nextPtr - sizeof(T) * numElements);
+		FreeAligned(address, sizeof(T) * numElements);
+	}
+
+	// free bytes allocated by AllocAligned
+	void FreeAligned(void* address, size_t bytes)
+	{
+		// assure address is the top allocation of the stack
+		ASSERT(address && (char*)address + bytes == m_nextPtr &&
+			"Freeing an allocation that isn't on top of the stack!");
 
-		// move stack pointer back down the stack
-		m_nextPtr -= sizeof(T) * numElements;
+		ALLOCATOR_STAT(m_stats.OnFree(address));
 
-		// reset bytes to 0 in reclaimed memory
-		std::memset(m_nextPtr, 0, sizeof(T) * numElements);
+		// move stack pointer back down past the allocation and its header
+		char* mem = (char*)address;
+		m_nextPtr = mem - reinterpret_cast<unsigned char*>(mem)[-1];
+
+		// reset bytes to 0 in reclaimed memory, header included
+		if (m_zeroOnFree)
+			std::memset(m_nextPtr, 0, mem + bytes - m_nextPtr);
 	}
 
 	template<typename T>
@@ -102,17 +186,176 @@ public:
 			address[i].~T();
 
 		// use free function
-		Free(address);
+		Free(address, numElements);
 	}
 
 	void Clear()
 	{
+		// give the used pages back to the OS, they read as zero when they're touched again
+		if (m_releaseOnClear)
+			m_arena->Release(0, m_nextPtr - m_memStack);
+
 		// reset stack pointer to the top
 		m_nextPtr = m_memStack;
+		ALLOCATOR_STAT(m_stats.OnClear());
+	}
+
+	// current top of the stack
+	Marker GetMarker() const
+	{
+		return m_nextPtr - m_memStack;
 	}
 
+	// free everything allocated since marker was taken, in one step
+	void FreeToMarker(Marker marker)
+	{
+		char* markerPtr = m_memStack + marker;
+		ASSERT(markerPtr <= m_nextPtr && "Marker is above the top of the stack, it was already freed past!");
+		ALLOCATOR_STAT(m_stats.OnFreeRange(markerPtr, m_nextPtr));
+
+		// reset bytes to 0 in reclaimed memory
+		if (m_zeroOnFree)
+			std::memset(markerPtr, 0, m_nextPtr - markerPtr);
+
+		m_nextPtr = markerPtr;
+	}
+
+#if ALLOCATOR_STATS
+	const AllocatorStats& Stats() const
+	{
+		return m_stats;
+	}
+#endif
+
 private:
-	size_t m_stackSize;	// size of allocated stack in bytes
-	char* m_memStack;	// ptr to bottom of the stack
-	char* m_nextPtr;	// ptr to current top of stack
+	// how far past top an allocation aligned to alignment starts, 1 to alignment bytes,
+	// so there's always room for its header byte
+	static size_t Adjustment(const char* top, size_t alignment)
+	{
+		uintptr_t address = reinterpret_cast<uintptr_t>(top);
+		return ((address + alignment) & ~(alignment - 1)) - address;
+	}
+
+	size_t m_stackSize;		// size of allocated stack in bytes
+	char* m_memStack;		// ptr to bottom of the stack
+	char* m_nextPtr;		// ptr to current top of stack
+	bool m_zeroOnFree;		// whether freed bytes are reset to 0
+	VirtualArena* m_arena;	// OS backed memory of the stack, nullptr if it's from malloc
+	bool m_releaseOnClear;	// whether Clear gives used pages back to the OS
+	ALLOCATOR_STAT(AllocatorStats m_stats{ "StackAllocator" };)	// instrumentation, if compiled in
+};
+
+// scope on a StackAllocator: everything allocated through (or on the stack during) the frame
+// is freed when the frame ends, in O(1) by rolling back to a marker.
+// objects made with Construct have their destructors run first, newest to oldest,
+// trivially destructible objects cost nothing extra.
+// frames nest, so subsystems can share one scratch stack without any bookkeeping:
+//	{
+//		StackFrame frame(scratch);
+//		Vec3* points = frame.Alloc<Vec3>(count);
+//		Path* path = frame.Construct<Path>(points, count);
+//	}	// path destructed, points and path freed
+class StackFrame
+{
+	// destructor to run when the frame ends, allocated on the stack before its objects
+	struct Destructor
+	{
+		void (*destroy)(void* objects, unsigned count);	// calls ~T on each object
+		void* objects;									// first object
+		unsigned count;									// number of objects
+		Destructor* next;								// older destructor
+	};
+
+	template<typename T>
+	static void Destroy(void* objects, unsigned count)
+	{
+		for (unsigned i = 0; i < count; ++i)
+			static_cast<T*>(objects)[i].~T();
+	}
+
+public:
+	explicit StackFrame(StackAllocator& stack)
+		: m_stack(stack), m_marker(stack.GetMarker()), m_destructors(nullptr) {}
+
+	~StackFrame()
+	{
+		// destruct newest to oldest
+		for (Destructor* d = m_destructors; d; d = d->next)
+			d->destroy(d->objects, d->count);
+
+		m_stack.FreeToMarker(m_marker);
+	}
+
+	StackFrame(const StackFrame&) = delete;
+	StackFrame& operator=(const StackFrame&) = delete;
+
+	// allocate without constructing, nothing is run when the frame ends
+	template<typename T>
+	T* Alloc(unsigned numElements = 1)
+	{
+		return m_stack.Alloc<T>(numElements);
+	}
+
+	// allocate raw bytes with an explicit alignment
+	void* AllocAligned(size_t bytes, size_t alignment)
+	{
+		return m_stack.AllocAligned(bytes, alignment);
+	}
+
+	// allocate and construct an object, destructed when the frame ends
+	template<typename T, typename... Args>
+	T* Construct(Args... args)
+	{
+		Destructor* d = RegisterDestructor<T>();
+		T* obj = new (m_stack.Alloc<T>()) T(args...);
+		Track(d, obj, 1);
+		return obj;
+	}
+
+	// allocate and default construct an array, destructed when the frame ends
+	template<typename T>
+	T* ConstructArray(unsigned numElements)
+	{
+		Destructor* d = RegisterDestructor<T>();
+		T* objs = m_stack.Alloc<T>(numElements);
+		for (unsigned i = 0; i < numElements; ++i)
+			new (objs + i) T();
+		Track(d, objs, numElements);
+		return objs;
+	}
+
+	// the stack this frame is on
+	StackAllocator& Stack() const
+	{
+		return m_stack;
+	}
+
+private:
+	// allocates a destructor record for T, nullptr if T doesn't need one
+	template<typename T>
+	Destructor* RegisterDestructor()
+	{
+		if (std::is_trivially_destructible<T>::value)
+			return nullptr;
+
+		Destructor* d = m_stack.Alloc<Destructor>();
+		d->destroy = &Destroy<T>;
+		return d;
+	}
+
+	// adds a destructor record once its objects are constructed
+	void Track(Destructor* d, void* objects, unsigned count)
+	{
+		if (d == nullptr)
+			return;
+
+		d->objects = objects;
+		d->count = count;
+		d->next = m_destructors;
+		m_destructors = d;
+	}
+
+	StackAllocator& m_stack;		// stack the frame is on
+	StackAllocator::Marker m_marker;	// top of the stack when the frame started
+	Destructor* m_destructors;		// destructors to run when the frame ends, newest first
 };
@@ -0,0 +1,130 @@
+//Matthew Rosen
+// multithreaded alloc/free stress test of PoolAllocator<T, LockFree>
+// build: g++ -std=c++17 -O2 -pthread -I.. LockFreeStressTest.cpp -o LockFreeStressTest
+// run it under ThreadSanitizer too: add -fsanitize=thread -g
+// usage: LockFreeStressTest [threads] [rounds]
+
+#include "PoolAllocator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// object stamped by whoever holds it, a block handed to two threads at once ends up with the wrong stamp
+struct Stamped
+{
+	unsigned thread;
+	unsigned round;
+	unsigned words[6];
+};
+
+static const unsigned BURST = 64;
+
+static std::atomic<unsigned> s_failures(0);
+
+static void Fail(const char* what)
+{
+	if (s_failures.fetch_add(1) < 10)
+		std::printf("FAILED: %s\n", what);
+}
+
+// each thread allocates a burst, stamps every object, yields, checks the stamps, then frees the burst
+template<typename Pool>
+static void Worker(Pool& pool, unsigned thread, unsigned rounds)
+{
+	Stamped* objects[BURST];
+	for (unsigned round = 0; round < rounds; ++round)
+	{
+		// half the rounds go through the batch calls
+		bool batch = (round & 1) != 0;
+		if (batch)
+			pool.AllocBatch(objects, BURST);
+		else
+		{
+			for (unsigned i = 0; i < BURST; ++i)
+				objects[i] = pool.Alloc();
+		}
+
+		for (unsigned i = 0; i < BURST; ++i)
+		{
+			if (objects[i] == nullptr)
+			{
+				Fail("Alloc returned nullptr");
+				return;
+			}
+			objects[i]->thread = thread;
+			objects[i]->round = round;
+			for (unsigned w = 0; w < 6; ++w)
+				objects[i]->words[w] = thread * 31 + round + w;
+		}
+
+		std::this_thread::yield();
+
+		for (unsigned i = 0; i < BURST; ++i)
+		{
+			bool intact = objects[i]->thread == thread && objects[i]->round == round;
+			for (unsigned w = 0; w < 6; ++w)
+				intact = intact && objects[i]->words[w] == thread * 31 + round + w;
+			if (!intact)
+				Fail("an object was handed out to two threads at once");
+		}
+
+		if (batch)
+			pool.FreeBatch(objects, BURST);
+		else
+		{
+			for (unsigned i = 0; i < BURST; ++i)
+				pool.Free(objects[i]);
+		}
+	}
+}
+
+// runs the workers, then checks every block is free and distinct
+template<typename Pool>
+static void Stress(const char* name, Pool& pool, unsigned numObjects, unsigned numThreads, unsigned rounds)
+{
+	std::vector<std::thread> threads;
+	for (unsigned t = 0; t < numThreads; ++t)
+		threads.emplace_back([&pool, t, rounds] { Worker(pool, t, rounds); });
+	for (std::thread& thread : threads)
+		thread.join();
+
+	if (pool.NumObjects() != 0)
+		Fail("NumObjects didn't return to 0");
+
+	// every block comes back out exactly once
+	std::vector<Stamped*> all(numObjects);
+	pool.AllocBatch(all.data(), numObjects);
+	std::sort(all.begin(), all.end());
+	if (std::adjacent_find(all.begin(), all.end()) != all.end())
+		Fail("the free list holds a block twice");
+	pool.FreeBatch(all.data(), numObjects);
+
+	std::printf("%s: %u threads, %u rounds of %u\n", name, numThreads, rounds, BURST);
+}
+
+int main(int argc, char** argv)
+{
+	unsigned numThreads = argc > 1 ? std::atoi(argv[1]) : 8;
+	unsigned rounds = argc > 2 ? std::atoi(argv[2]) : 20000;
+	unsigned numObjects = numThreads * BURST;
+
+	// exactly enough blocks for every thread's burst, so they're recycled as fast as possible
+	PoolAllocator<Stamped, LockFree> fixed(numObjects, poFixed);
+	Stress("fixed", fixed, numObjects, numThreads, rounds);
+
+	// too few blocks, so threads race to add pages
+	PoolAllocator<Stamped, LockFree> paged(BURST, poPaged, pcRetainPages, 4096);
+	Stress("paged", paged, numObjects, numThreads, rounds);
+
+	if (s_failures)
+	{
+		std::printf("LockFreeStressTest failed\n");
+		return 1;
+	}
+	std::printf("LockFreeStressTest passed\n");
+	return 0;
+}
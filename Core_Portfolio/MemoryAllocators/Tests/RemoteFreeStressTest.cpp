@@ -0,0 +1,195 @@
+//Matthew Rosen
+// cross thread free stress test of PoolAllocator<T, ThreadOwned>
+// build: g++ -std=c++17 -O2 -pthread -I.. RemoteFreeStressTest.cpp -o RemoteFreeStressTest
+// run it under ThreadSanitizer too: add -fsanitize=thread -g
+// usage: RemoteFreeStressTest [consumers] [rounds]
+
+#include "PoolAllocator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// object stamped by the owner, a block handed out twice ends up with the wrong serial
+struct Stamped
+{
+	unsigned serial;
+	unsigned words[7];
+};
+
+// object on its way to a consumer, with the serial it was stamped with
+struct Handoff
+{
+	Stamped* object;
+	unsigned serial;
+};
+
+// objects handed from the owner to one consumer
+struct Mailbox
+{
+	std::mutex lock;
+	std::vector<Handoff> objects;
+};
+
+static const unsigned BURST = 64;
+
+static std::atomic<unsigned> s_failures(0);
+
+static void Fail(const char* what)
+{
+	if (s_failures.fetch_add(1) < 10)
+		std::printf("FAILED: %s\n", what);
+}
+
+static void Stamp(Stamped* object, unsigned serial)
+{
+	object->serial = serial;
+	for (unsigned w = 0; w < 7; ++w)
+		object->words[w] = serial * 31 + w;
+}
+
+static bool Intact(const Stamped* object, unsigned serial)
+{
+	bool intact = object->serial == serial;
+	for (unsigned w = 0; w < 7; ++w)
+		intact = intact && object->words[w] == serial * 31 + w;
+	return intact;
+}
+
+// takes whatever is in the mailbox, checks the stamps and frees the objects, until the owner is done
+// freed counts them, so the owner knows how many blocks it has back
+template<typename Pool>
+static void Consumer(Pool& pool, Mailbox& mailbox, std::atomic<unsigned>& freed, const std::atomic<bool>& done)
+{
+	std::vector<Handoff> objects;
+	for (;;)
+	{
+		bool finished = done.load(std::memory_order_acquire);
+		{
+			std::lock_guard<std::mutex> lock(mailbox.lock);
+			objects.swap(mailbox.objects);
+		}
+
+		if (objects.empty())
+		{
+			if (finished)
+				return;
+			std::this_thread::yield();
+			continue;
+		}
+
+		for (const Handoff& handoff : objects)
+		{
+			if (!Intact(handoff.object, handoff.serial))
+				Fail("an object was handed out twice");
+			pool.Free(handoff.object);
+			freed.fetch_add(1, std::memory_order_release);
+		}
+		objects.clear();
+	}
+}
+
+// the owner allocates bursts, stamps them, frees every 4th object itself and mails the rest to the consumers.
+// once they're done it checks every block is free and distinct, since only it may allocate
+template<typename Pool>
+static void Owner(Pool& pool, unsigned numObjects, unsigned numConsumers, unsigned rounds)
+{
+	std::vector<Mailbox> mailboxes(numConsumers);
+	std::atomic<unsigned> freed(0);
+	std::atomic<bool> done(false);
+	std::vector<std::thread> consumers;
+	for (unsigned c = 0; c < numConsumers; ++c)
+		consumers.emplace_back([&pool, &mailboxes, &freed, &done, c] { Consumer(pool, mailboxes[c], freed, done); });
+
+	unsigned serial = 0;
+	unsigned sent = 0;
+	Stamped* objects[BURST];
+	for (unsigned round = 0; round < rounds; ++round)
+	{
+		Mailbox& mailbox = mailboxes[round % numConsumers];
+
+		// wait for the consumers to free enough that a burst fits, so a fixed pool never runs out
+		while (sent - freed.load(std::memory_order_acquire) + BURST > numObjects)
+			std::this_thread::yield();
+
+		// half the rounds go through the batch call
+		if (round & 1)
+			pool.AllocBatch(objects, BURST);
+		else
+		{
+			for (unsigned i = 0; i < BURST; ++i)
+				objects[i] = pool.Alloc();
+		}
+
+		std::vector<Handoff> handoffs;
+		for (unsigned i = 0; i < BURST; ++i)
+		{
+			Stamp(objects[i], ++serial);
+			if (i % 4 == 0)
+				pool.Free(objects[i]);
+			else
+				handoffs.push_back(Handoff{ objects[i], serial });
+		}
+		sent += static_cast<unsigned>(handoffs.size());
+
+		std::lock_guard<std::mutex> lock(mailbox.lock);
+		mailbox.objects.insert(mailbox.objects.end(), handoffs.begin(), handoffs.end());
+	}
+
+	done.store(true, std::memory_order_release);
+	for (std::thread& consumer : consumers)
+		consumer.join();
+
+	if (pool.NumObjects() != 0)
+		Fail("NumObjects didn't return to 0");
+
+	// every block comes back out exactly once, including the ones sitting in the inbox
+	std::vector<Stamped*> all(numObjects);
+	pool.AllocBatch(all.data(), numObjects);
+	std::sort(all.begin(), all.end());
+	if (std::adjacent_find(all.begin(), all.end()) != all.end())
+		Fail("the free list holds a block twice");
+	pool.FreeBatch(all.data(), numObjects);
+}
+
+// runs an owner thread against the consumers, then clears the pool from this thread
+// and checks another thread can own it (allocating from a pool it doesn't own asserts)
+template<typename Pool>
+static void Stress(const char* name, Pool& pool, unsigned numObjects, unsigned numConsumers, unsigned rounds)
+{
+	std::thread([&] { Owner(pool, numObjects, numConsumers, rounds); }).join();
+
+	pool.Clear();
+	std::thread([&] { Owner(pool, numObjects, numConsumers, rounds / 10); }).join();
+
+	std::printf("%s: %u consumers, %u rounds of %u\n", name, numConsumers, rounds, BURST);
+}
+
+int main(int argc, char** argv)
+{
+	unsigned numConsumers = argc > 1 ? std::atoi(argv[1]) : 4;
+	unsigned rounds = argc > 2 ? std::atoi(argv[2]) : 20000;
+	if (numConsumers == 0)
+		numConsumers = 1;
+	unsigned numObjects = numConsumers * BURST * 4;
+
+	// a few bursts per consumer, so the owner often has to wait for the consumers
+	PoolAllocator<Stamped, ThreadOwned> fixed(numObjects, poFixed);
+	Stress("fixed", fixed, numObjects, numConsumers, rounds);
+
+	// too few blocks to start with, so the pool grows pages, and keeps them when it's cleared
+	PoolAllocator<Stamped, ThreadOwned> paged(BURST, poPaged, pcRetainPages, 4096);
+	Stress("paged", paged, numObjects, numConsumers, rounds);
+
+	if (s_failures)
+	{
+		std::printf("RemoteFreeStressTest failed\n");
+		return 1;
+	}
+	std::printf("RemoteFreeStressTest passed\n");
+	return 0;
+}
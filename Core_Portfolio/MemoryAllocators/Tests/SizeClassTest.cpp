@@ -0,0 +1,102 @@
+//Matthew Rosen
+// checks the per class statistics of SizeClassAllocator
+// build: g++ -std=c++17 -O2 -pthread -I.. SizeClassTest.cpp -o SizeClassTest
+
+// the per class statistics are only kept with instrumentation compiled in
+#define ALLOCATOR_STATS 1
+
+#include "SizeClassAllocator.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <new>
+
+// fails the test with a message
+#define CHECK(condition) if((condition)) {} else { std::printf("FAILED: %s (%s:%d)\n", #condition, __FILE__, __LINE__); return 1; }
+
+template<typename ThreadPolicy>
+static int TestStats()
+{
+	// made over memory full of garbage, so counters that aren't initialized show up
+	alignas(SizeClassAllocator<ThreadPolicy>) static unsigned char memory[sizeof(SizeClassAllocator<ThreadPolicy>)];
+	for (unsigned char& byte : memory)
+		byte = 0xcd;
+	SizeClassAllocator<ThreadPolicy>* allocator = new (memory) SizeClassAllocator<ThreadPolicy>();
+
+	for (unsigned c = 0; c <= allocator->NumClasses(); ++c)
+	{
+		CHECK(allocator->Stats(c).allocs == 0);
+		CHECK(allocator->Stats(c).frees == 0);
+		CHECK(allocator->Stats(c).Live() == 0);
+	}
+
+	// 3 allocations of 24 bytes, 1 of 100, 1 oversize
+	const unsigned c24 = allocator->ClassOf(24);
+	const unsigned c100 = allocator->ClassOf(100);
+	const unsigned oversize = allocator->NumClasses();
+	void* a = allocator->Alloc(24);
+	void* b = allocator->Alloc(24);
+	void* c = allocator->Alloc(24);
+	void* d = allocator->Alloc(100);
+	void* e = allocator->Alloc(4096);
+	CHECK(allocator->Stats(c24).Live() == 3);
+	CHECK(allocator->Stats(c100).Live() == 1);
+	CHECK(allocator->Stats(oversize).Live() == 1);
+
+	allocator->Free(b, 24);
+	allocator->Free(e, 4096);
+	CHECK(allocator->Stats(c24).allocs == 3);
+	CHECK(allocator->Stats(c24).frees == 1);
+	CHECK(allocator->Stats(c24).Live() == 2);
+	CHECK(allocator->Stats(oversize).Live() == 0);
+
+	allocator->Free(a, 24);
+	allocator->Free(c, 24);
+	allocator->Free(d, 100);
+	for (unsigned i = 0; i <= allocator->NumClasses(); ++i)
+		CHECK(allocator->Stats(i).Live() == 0);
+
+	allocator->~SizeClassAllocator<ThreadPolicy>();
+	return 0;
+}
+
+struct Small : SmallObject
+{
+	char bytes[24];
+};
+
+struct alignas(16) Aligned16 : SmallObject
+{
+	char bytes[80];
+};
+
+struct alignas(64) Aligned64 : SmallObject
+{
+	char bytes[40];
+};
+
+// SmallObject's new respects the alignment of the class
+static int TestSmallObjectAlignment()
+{
+	for (unsigned i = 0; i < 100; ++i)
+	{
+		Small* small = new Small;
+		Aligned16* aligned16 = new Aligned16;
+		Aligned64* aligned64 = new Aligned64;
+		CHECK(reinterpret_cast<uintptr_t>(small) % alignof(Small) == 0);
+		CHECK(reinterpret_cast<uintptr_t>(aligned16) % 16 == 0);
+		CHECK(reinterpret_cast<uintptr_t>(aligned64) % 64 == 0);
+		delete small;
+		delete aligned16;
+		delete aligned64;
+	}
+	return 0;
+}
+
+int main()
+{
+	if (TestStats<SingleThreaded>() || TestStats<LockFree>() || TestSmallObjectAlignment())
+		return 1;
+	std::printf("SizeClassTest passed\n");
+	return 0;
+}
@@ -0,0 +1,133 @@
+//Matthew Rosen
+// checks handle staleness and swap remove of SlotMap
+// build: g++ -std=c++17 -O2 -pthread -I.. SlotMapTest.cpp -o SlotMapTest
+
+#include "SlotMap.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// fails the test with a message
+#define CHECK(condition) if((condition)) {} else { std::printf("FAILED: %s (%s:%d)\n", #condition, __FILE__, __LINE__); return 1; }
+
+// object that counts how many are alive, and owns memory so a bad move shows up
+struct Tracked
+{
+	static int s_live;
+
+	std::string name;
+	int value;
+
+	Tracked(const char* name, int value) : name(name), value(value) { ++s_live; }
+	Tracked(Tracked&& other) : name(std::move(other.name)), value(other.value) { ++s_live; }
+	~Tracked() { --s_live; }
+};
+
+int Tracked::s_live = 0;
+
+// handles to erased objects stop resolving, and can't erase again
+static int TestStaleHandles()
+{
+	SlotMap<Tracked> map(16);
+	CHECK(!map.Get(SlotHandle()));
+	CHECK(!map.Contains(SlotHandle()));
+
+	SlotHandle a = map.Insert("a", 1);
+	SlotHandle b = map.Insert("b", 2);
+	CHECK(map.Get(a) && map.Get(a)->value == 1);
+	CHECK(map.Get(b) && map.Get(b)->value == 2);
+
+	CHECK(map.Erase(a));
+	CHECK(!map.Contains(a));
+	CHECK(!map.Get(a));
+	CHECK(!map.Erase(a));
+	CHECK(map.Size() == 1);
+	CHECK(map.Get(b)->value == 2);
+
+	// clear stales every handle
+	map.Clear();
+	CHECK(!map.Get(b));
+	CHECK(map.Size() == 0);
+	CHECK(Tracked::s_live == 0);
+	return 0;
+}
+
+// a reused slot gets a new generation, so old handles to it don't resolve to the new object
+static int TestGenerations()
+{
+	SlotMap<Tracked> map(4);
+	SlotHandle first = map.Insert("first", 1);
+	for (unsigned i = 0; i < 100; ++i)
+	{
+		CHECK(map.Erase(first));
+		SlotHandle reused = map.Insert("reused", 2);
+		CHECK(reused.index == first.index);
+		CHECK(reused.generation != first.generation);
+		CHECK(reused != first);
+		CHECK(!map.Get(first));
+		CHECK(!map.Erase(first));
+		CHECK(map.Get(reused)->value == 2);
+		first = reused;
+	}
+	CHECK(map.Size() == 1);
+	return 0;
+}
+
+// erasing moves the last object into the hole: the live objects stay contiguous,
+// and every remaining handle still finds its own object
+static int TestSwapRemove()
+{
+	const int NUM_OBJECTS = 1000;
+	std::vector<SlotHandle> handles;
+	{
+		SlotMap<Tracked> map(NUM_OBJECTS);
+		for (int i = 0; i < NUM_OBJECTS; ++i)
+			handles.push_back(map.Insert("object", i));
+
+		// erase every 3rd object, from the front to the very end (NUM_OBJECTS - 1 is the last one)
+		for (int i = 0; i < NUM_OBJECTS; i += 3)
+			CHECK(map.Erase(handles[i]));
+		CHECK(Tracked::s_live == (int)map.Size());
+
+		int sum = 0;
+		int expected = 0;
+		for (int i = 0; i < NUM_OBJECTS; ++i)
+		{
+			if (i % 3 == 0)
+			{
+				CHECK(!map.Get(handles[i]));
+				continue;
+			}
+			expected += i;
+			Tracked* object = map.Get(handles[i]);
+			CHECK(object && object->value == i && object->name == "object");
+			CHECK(object >= map.begin() && object < map.end());
+		}
+
+		// iteration visits exactly the live objects, packed front to back
+		CHECK(map.end() - map.begin() == (long)map.Size());
+		for (Tracked& object : map)
+			sum += object.value;
+		CHECK(sum == expected);
+
+		// HandleAt walks the same order as the iterator
+		for (unsigned i = 0; i < map.Size(); ++i)
+			CHECK(map.Get(map.HandleAt(i)) == map.begin() + i);
+
+		// the freed slots fill the map back up
+		while (map.Size() < map.Capacity())
+			map.Insert("refill", -1);
+		CHECK(Tracked::s_live == NUM_OBJECTS);
+	}
+	CHECK(Tracked::s_live == 0);
+	return 0;
+}
+
+int main()
+{
+	if (TestStaleHandles() || TestGenerations() || TestSwapRemove())
+		return 1;
+	std::printf("SlotMapTest passed\n");
+	return 0;
+}
@@ -0,0 +1,160 @@
+//Matthew Rosen
+#pragma once
+
+#include "AllocatorDebug.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// when an arena's pages get physical memory
+enum ArenaCommit
+{
+	acLazy,			// on first touch, so memory that's never used is never paid for
+	acPopulate		// all up front, so there are no page faults later
+};
+
+// options of an OS backed arena, for allocators that can use one instead of malloc
+struct ArenaOptions
+{
+	ArenaCommit commit = acLazy;	// when pages get physical memory
+	bool hugePages = false;			// ask for transparent huge pages (Linux), fewer TLB misses for big arenas
+	bool releaseOnClear = false;	// give the pages back to the OS when the allocator is cleared
+};
+
+// size of a transparent huge page, the arena is aligned to it when huge pages are asked for
+static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+// range of address space straight from the OS (mmap, or VirtualAlloc on Windows)
+// the memory starts out zeroed, and pages given back with Release read as zero again.
+// huge pages are only a hint: Linux uses them if transparent huge pages are enabled,
+// Windows needs a privilege for large pages, so they aren't used there.
+class VirtualArena
+{
+public:
+	VirtualArena(size_t bytes, const ArenaOptions& options = ArenaOptions())
+		: m_base(nullptr), m_size(0), m_reserved(nullptr), m_reservedSize(0)
+	{
+		m_pageSize = OsPageSize();
+		size_t alignment = options.hugePages ? HUGE_PAGE_SIZE : m_pageSize;
+		m_size = RoundUp(bytes ? bytes : 1, alignment);
+
+#if defined(_WIN32)
+		m_reserved = static_cast<char*>(VirtualAlloc(nullptr, m_size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+		ASSERT(m_reserved && "reserving address space for arena failed!");
+		m_reservedSize = m_size;
+		m_base = m_reserved;
+#else
+		// reserve an extra huge page so the arena can be aligned to one
+		int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+		flags |= MAP_NORESERVE;
+#endif
+		m_reservedSize = m_size + (alignment > m_pageSize ? alignment : 0);
+		void* reserved = mmap(nullptr, m_reservedSize, PROT_READ | PROT_WRITE, flags, -1, 0);
+		ASSERT(reserved != MAP_FAILED && "reserving address space for arena failed!");
+		m_reserved = static_cast<char*>(reserved);
+		m_base = reinterpret_cast<char*>(RoundUp(reinterpret_cast<uintptr_t>(m_reserved), alignment));
+
+#ifdef MADV_HUGEPAGE
+		if (options.hugePages)
+			madvise(m_base, m_size, MADV_HUGEPAGE);
+#endif
+#endif
+
+		// fault in every page now (after the huge page hint, so the faults can use huge pages)
+		if (options.commit == acPopulate)
+			Populate();
+	}
+
+	~VirtualArena()
+	{
+#if defined(_WIN32)
+		VirtualFree(m_reserved, 0, MEM_RELEASE);
+#else
+		munmap(m_reserved, m_reservedSize);
+#endif
+	}
+
+	VirtualArena(const VirtualArena&) = delete;
+	VirtualArena& operator=(const VirtualArena&) = delete;
+
+	char* Base() const
+	{
+		return m_base;
+	}
+
+	// usable bytes, the size asked for rounded up to whole pages
+	size_t Size() const
+	{
+		return m_size;
+	}
+
+	// gives the whole pages within [offset, offset + bytes) back to the OS, they read as zero after
+	void Release(size_t offset, size_t bytes)
+	{
+		size_t begin = RoundUp(offset, m_pageSize);
+		size_t end = (offset + bytes < m_size ? offset + bytes : m_size) & ~(m_pageSize - 1);
+		if (end <= begin)
+			return;
+
+#if defined(_WIN32)
+		VirtualFree(m_base + begin, end - begin, MEM_DECOMMIT);
+		VirtualAlloc(m_base + begin, end - begin, MEM_COMMIT, PAGE_READWRITE);
+#else
+		madvise(m_base + begin, end - begin, MADV_DONTNEED);
+#endif
+	}
+
+	void ReleaseAll()
+	{
+		Release(0, m_size);
+	}
+
+	// faults in every page
+	void Populate()
+	{
+#if defined(MADV_POPULATE_WRITE)
+		if (madvise(m_base, m_size, MADV_POPULATE_WRITE) == 0)
+			return;
+#endif
+		// write one byte per page (a zero, which doesn't change anything)
+		for (size_t offset = 0; offset < m_size; offset += m_pageSize)
+			reinterpret_cast<volatile char*>(m_base)[offset] = 0;
+	}
+
+	static size_t OsPageSize()
+	{
+#if defined(_WIN32)
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return info.dwPageSize;
+#else
+		return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+	}
+
+private:
+	static size_t RoundUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	char* m_base;				// start of the usable, aligned range
+	size_t m_size;				// usable bytes
+	char* m_reserved;			// start of the whole reserved range
+	size_t m_reservedSize;		// bytes reserved, including alignment slack
+	size_t m_pageSize;			// OS page size
+};